@@ -0,0 +1,76 @@
+#include <iostream>
+#include <cstring>
+
+#include "Benchmarks.h"
+
+/*
+ * ParticleBench: micro-benchmarks and accuracy checks for the core.
+ *
+ * Usage:
+ *   ParticleBench <benchmark> [--key value ...]
+ *   ParticleBench list
+ */
+
+struct BenchEntry{
+    const char* name;
+    const char* description;
+    int (*run)(const BenchArgs&);
+};
+
+static const BenchEntry benchmarks[] = {
+    { "integration", "SIMD Verlet/gravity kernel vs VerletIntegration (--particles --steps --tolerance)", benchIntegration },
+    { "gravity",     "Mutual gravity solvers: time and force error vs direct summation (--particles --theta a,b,c --mesh a,b --order a,b --fmm-theta t --threads)", benchGravity },
+    { "reorder",     "Morton reorder: step time and cache misses per reorder interval (--particles --steps --interval a,b --radius --threads)", benchReorder },
+    { "polydisperse", "Hierarchical grid contact check and step time per collision mode for mixed sizes (--particles --steps --radius --ratio a,b --modes a,b --threads)", benchPolydisperse },
+    { "contacts",    "Velocity swap vs XPBD contact solver: residual overlap and step time on a stack and a pile (--particles --width --height --steps --settle --radius --iterations a,b --threads)", benchContacts },
+    { "timesteps",   "Block vs global timesteps on eccentric orbits: time and energy error (--particles --seconds --dt --levels --accuracy a,b --threads)", benchTimesteps },
+    { "integrators", "Splitting integrators on eccentric orbits: force evaluations and energy error per step size (--particles --seconds --schemes a,b --dt a,b --target --reorder --threads)", benchIntegrators },
+    { "ccd",         "Discrete vs continuous collisions on a fast gas: tunnelled pairs and energy error per step size (--particles --radius --speed --dt --seconds --factors a,b --threads)", benchCcd },
+    { "hardspheres", "Event-driven hard spheres vs time-stepped collisions on a dilute gas: time, collision rate and energy drift (--particles --radius --speed --seconds --frame --rates a,b --threads)", benchHardSpheres },
+};
+
+static void listBenchmarks(){
+    for(const auto& entry : benchmarks){
+        std::cout << "  " << entry.name << "\n      " << entry.description << "\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || std::strcmp(argv[1], "list") == 0){
+        std::cout << "Usage: " << argv[0] << " <benchmark> [--key value ...]\n";
+        listBenchmarks();
+        return argc < 2 ? 1 : 0;
+    }
+
+    BenchArgs args;
+    for(int i = 2; i < argc; i += 2){
+        if (std::strncmp(argv[i], "--", 2) != 0){
+            std::cerr << "Expected --key value, got " << argv[i] << std::endl;
+            return 1;
+        }
+        if (i + 1 == argc){
+            std::cerr << "Expected a value after " << argv[i] << std::endl;
+            return 1;
+        }
+        args.values[argv[i] + 2] = argv[i + 1];
+    }
+
+    for(const auto& entry : benchmarks){
+        if (std::strcmp(argv[1], entry.name) == 0){
+            int result = entry.run(args);
+
+            // a misspelt key would otherwise pass unnoticed as its default
+            for(const auto& value : args.values){
+                if (args.used.count(value.first) == 0){
+                    std::cerr << "Warning: " << entry.name << " ignored unknown option --" << value.first << std::endl;
+                }
+            }
+            return result;
+        }
+    }
+
+    std::cerr << "Unknown benchmark " << argv[1] << "\n";
+    listBenchmarks();
+    return 1;
+}
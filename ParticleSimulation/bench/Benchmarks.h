@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+
+/*
+ * Shared pieces of the ParticleBench executable.
+ *
+ * Each benchmark is a function taking its parsed --key value options and
+ * returning the process exit code, so a failed accuracy check fails the
+ * run. New benchmarks are added to the table in BenchMain.cpp.
+ */
+
+class BenchArgs{
+  public:
+    std::map<std::string, std::string> values;
+
+    // keys the benchmark asked for, so the ones it never read can be reported
+    mutable std::set<std::string> used;
+
+    int getInt(const std::string& key, int fallback) const {
+      used.insert(key);
+      auto it = values.find(key);
+      return it == values.end() ? fallback : std::stoi(it->second);
+    }
+
+    double getDouble(const std::string& key, double fallback) const {
+      used.insert(key);
+      auto it = values.find(key);
+      return it == values.end() ? fallback : std::stod(it->second);
+    }
+
+    std::string getString(const std::string& key, const std::string& fallback) const {
+      used.insert(key);
+      auto it = values.find(key);
+      return it == values.end() ? fallback : it->second;
+    }
+};
+
+// Seconds since construction
+class BenchTimer{
+  public:
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    double seconds() const {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+int benchIntegration(const BenchArgs& args);
+int benchGravity(const BenchArgs& args);
+int benchReorder(const BenchArgs& args);
+int benchPolydisperse(const BenchArgs& args);
+int benchContacts(const BenchArgs& args);
+int benchTimesteps(const BenchArgs& args);
+int benchIntegrators(const BenchArgs& args);
+int benchCcd(const BenchArgs& args);
+int benchHardSpheres(const BenchArgs& args);
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Scenes.h"
+#include "Simulation.h"
+
+/*
+ * Discrete against continuous collision detection on a fast gas.
+ *
+ * Particles fly at --speed through the boundary sphere with gravity off,
+ * so every change of course is a collision. After each step the pairs
+ * apart at both ends of it are checked: if the straight line between
+ * their two separations cuts into the contact distance, the pair touched
+ * during the step without being resolved (a missed contact), and if it
+ * cuts more than half way in, they passed through each other (tunnelled).
+ * A resolved collision swaps the velocities, which turns the separation
+ * back, so it never counts. The runs step at --dt times each --factors
+ * entry, with and without CCD, and are compared to a CCD run at a quarter
+ * of --dt on kinetic energy: every pair or boundary collision takes its
+ * share of the damping, so collisions that were missed show up as energy
+ * left over.
+ */
+
+struct PassCounts{
+    int missed = 0;
+    int tunnelled = 0;
+};
+
+// Pairs whose separation went straight into or through contact between two snapshots
+static PassCounts countPasses(const ParticleSystem& before, const ParticleSystem& after){
+    std::vector<int> indices(after.size());
+    float maxRadius = 0.0f;
+    for(int i = 0; i < (int)after.size(); i++){
+        indices[i] = i;
+        maxRadius = std::max(maxRadius, after.radius[i] + 0.5f * glm::length(after.position(i) - before.position(i)));
+    }
+
+    SpatialGrid grid;
+    grid.build(indices, [&](int i){ return 0.5f * (before.position(i) + after.position(i)); }, maxRadius);
+
+    PassCounts counts;
+    grid.forEachPair([&](int i, int j){
+        float contact = after.radius[i] + after.radius[j];
+        glm::vec3 d0 = before.position(j) - before.position(i);
+        glm::vec3 d1 = after.position(j) - after.position(i);
+        if (glm::length(d0) < contact || glm::length(d1) < contact){
+            return;
+        }
+
+        // closest point of the segment d0 -> d1 to the origin
+        glm::vec3 e = d1 - d0;
+        float t = -glm::dot(d0, e) / std::max(glm::dot(e, e), 1e-12f);
+        if (t <= 0.0f || t >= 1.0f){
+            return;
+        }
+        float closest = glm::length(d0 + t * e);
+        counts.missed += closest < contact ? 1 : 0;
+        counts.tunnelled += closest < 0.5f * contact ? 1 : 0;
+    });
+    return counts;
+}
+
+struct GasRun{
+    double seconds = 0.0;
+    long long missed = 0, tunnelled = 0;
+    double kineticEnergy = 0.0;
+    double impacts = 0.0;
+};
+
+static GasRun runGas(int numParticles, float radius, float speed, float deltaTime, double duration, bool continuous, int threads){
+    Simulation sim;
+    sim.setThreadCount(threads);
+    sim.params.gConstant = 0.0f;
+    sim.reorderInterval = 0;
+    sim.continuousCollisions = continuous;
+    addGasScene(sim, numParticles, radius, speed, 3);
+
+    GasRun run;
+    int numSteps = std::max((int)std::lround(duration / deltaTime), 1);
+    ParticleSystem before;
+
+    for(int s = 0; s < numSteps; s++){
+        before = sim.particles;
+
+        BenchTimer timer;
+        sim.step(deltaTime);
+        run.seconds += timer.seconds();
+
+        PassCounts counts = countPasses(before, sim.particles);
+        run.missed += counts.missed;
+        run.tunnelled += counts.tunnelled;
+        run.impacts += sim.sweptCollisions.lastImpacts;
+    }
+    run.kineticEnergy = sim.kineticEnergy();
+    return run;
+}
+
+int benchCcd(const BenchArgs& args){
+
+    int numParticles = args.getInt("particles", 2000);
+    float radius = (float)args.getDouble("radius", 10.0);
+    float speed = (float)args.getDouble("speed", 400.0);
+    float deltaTime = (float)args.getDouble("dt", 1.0 / 240.0);
+    double duration = args.getDouble("seconds", 2.0);
+    int threads = args.getInt("threads", 0);
+    std::string factors = args.getString("factors", "1,2,4,8,16");
+
+    GasRun reference = runGas(numParticles, radius, speed, 0.25f * deltaTime, duration, true, threads);
+
+    std::cout << numParticles << " particles of radius " << radius << " at " << speed << " units/s, "
+              << duration << " s simulated; reference (CCD at dt/4) kinetic energy " << reference.kineticEnergy << "\n";
+
+    std::stringstream factorList(factors);
+    std::string factor;
+    while(std::getline(factorList, factor, ',')){
+        float stepDt = deltaTime * std::stof(factor);
+
+        for(bool continuous : { false, true }){
+            GasRun run = runGas(numParticles, radius, speed, stepDt, duration, continuous, threads);
+
+            std::string label = (continuous ? "ccd " : "discrete ") + factor + "x";
+            label.resize(std::max((int)label.size(), 14), ' ');
+            std::cout << "  " << label << run.seconds * 1e3 / duration << " ms per simulated s, "
+                      << run.missed / duration << " missed contacts/s, " << run.tunnelled / duration << " tunnelled/s"
+                      << ", kinetic energy " << (run.kineticEnergy / reference.kineticEnergy - 1.0) * 100.0 << "% off";
+            if (continuous){
+                std::cout << ", " << run.impacts / duration << " impacts/s";
+            }
+            std::cout << "\n";
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Scenes.h"
+#include "Simulation.h"
+
+/*
+ * Contact responses on a stack and a pile.
+ *
+ * The stack is a block of touching columns resting on the bottom of the
+ * boundary, the pile a cloud that has settled into the bottom of the
+ * gravity well. Each is stepped with the velocity-swap response and with
+ * the XPBD solver at every requested iteration count. The report is the
+ * time per step against the overlap left at the end (mean and 99th
+ * percentile over the touching pairs, as a fraction of the contact
+ * distance) and the kinetic energy, which stays high while a pile
+ * jitters. The percentile leaves out the few particles crushed into the
+ * attractor, where no response keeps them apart.
+ */
+
+struct OverlapStats{
+    int touching = 0;
+    double mean = 0.0;
+    double percentile99 = 0.0;
+};
+
+static OverlapStats measureOverlap(const Simulation& sim){
+    const ParticleSystem& ps = sim.particles;
+
+    float maxRadius = 0.0f;
+    for(int i : sim.activeParticles){
+        maxRadius = std::max(maxRadius, ps.radius[i]);
+    }
+
+    SpatialGrid grid;
+    grid.build(sim.activeParticles, [&](int i){ return ps.position(i); }, maxRadius);
+
+    std::vector<double> overlaps;
+    grid.forEachPair([&](int i, int j){
+        float contact = ps.radius[i] + ps.radius[j];
+        float overlap = contact - glm::length(ps.position(j) - ps.position(i));
+        if (overlap > 0.0f){
+            overlaps.push_back(overlap / contact);
+        }
+    });
+
+    OverlapStats stats;
+    stats.touching = (int)overlaps.size();
+    if (!overlaps.empty()){
+        for(double overlap : overlaps){
+            stats.mean += overlap;
+        }
+        stats.mean /= overlaps.size();
+
+        auto rank = overlaps.begin() + (overlaps.size() * 99) / 100;
+        std::nth_element(overlaps.begin(), rank, overlaps.end());
+        stats.percentile99 = *rank;
+    }
+    return stats;
+}
+
+int benchContacts(const BenchArgs& args){
+
+    int numParticles = args.getInt("particles", 20000);
+    int width = args.getInt("width", 10);
+    int height = args.getInt("height", 20);
+    int numSteps = args.getInt("steps", 300);
+    int settleSteps = args.getInt("settle", 600);
+    int threads = args.getInt("threads", 0);
+    float radius = (float)args.getDouble("radius", 3.0);
+    std::string iterations = args.getString("iterations", "1,2,4,8,16");
+    const float deltaTime = 1.0f / 240.0f;
+
+    // the settled pile is the starting point of every pile run
+    Simulation pile;
+    pile.setThreadCount(threads);
+    addCloudScene(pile, numParticles, radius, 5);
+    for(int s = 0; s < settleSteps; s++){
+        pile.step(deltaTime);
+    }
+
+    std::cout << "stack: " << width << "x" << width << "x" << height << ", pile: " << numParticles
+              << " particles settled for " << settleSteps << " steps, radius " << radius
+              << ", steps: " << numSteps << "\n";
+
+    // "swap" and then XPBD at each iteration count
+    std::vector<int> iterationCounts = { 0 };
+    std::stringstream iterationList(iterations);
+    std::string count;
+    while(std::getline(iterationList, count, ',')){
+        iterationCounts.push_back(std::max(std::stoi(count), 1));
+    }
+
+    for(const char* scene : { "stack", "pile" }){
+        std::cout << scene << ":\n";
+
+        for(int solverIterations : iterationCounts){
+            Simulation sim;
+            sim.setThreadCount(threads);
+            if (scene == std::string("stack")){
+                addStackScene(sim, width, height, radius, 5);
+            }
+            else{
+                sim.particles = pile.particles;
+                sim.spawnTimes = pile.spawnTimes;
+                sim.elapsedTime = pile.elapsedTime;
+            }
+
+            if (solverIterations > 0){
+                sim.contactResponse = ContactResponse::XPBD;
+                sim.contactSolver.iterations = solverIterations;
+            }
+
+            BenchTimer timer;
+            for(int s = 0; s < numSteps; s++){
+                sim.step(deltaTime);
+            }
+            double seconds = timer.seconds();
+
+            OverlapStats overlap = measureOverlap(sim);
+            std::string label = solverIterations > 0 ? "xpbd x" + std::to_string(solverIterations) : "swap";
+            label.resize(std::max((int)label.size(), 9), ' ');
+
+            std::cout << "  " << label << seconds * 1e3 / numSteps << " ms/step"
+                      << ", overlap mean " << overlap.mean * 100.0 << "% p99 " << overlap.percentile99 * 100.0 << "%"
+                      << " (" << overlap.touching << " pairs)"
+                      << ", kinetic energy " << sim.kineticEnergy();
+            if (solverIterations > 0){
+                std::cout << ", " << sim.contactSolver.colourCount() << " colours";
+            }
+            std::cout << "\n";
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "BarnesHut.h"
+#include "DirectGravity.h"
+#include "FastMultipole.h"
+#include "ParticleMesh.h"
+#include "Scenes.h"
+
+/*
+ * Accuracy and cost of the mutual gravity solvers on a uniform cloud.
+ *
+ * Direct summation with double accumulation is the reference. Every
+ * solver reports wall time, interactions per second where that means
+ * something, and the RMS / max relative force error against the
+ * reference. The FMM rows sweep the expansion order at one opening
+ * angle, to pick the cheapest order that meets an error target.
+ */
+
+struct ForceError{
+    double rms = 0.0, max = 0.0;
+};
+
+static ForceError compareForces(const ParticleSystem& reference, const ParticleSystem& test){
+    ForceError error;
+    int n = (int)reference.size();
+    for(int i = 0; i < n; i++){
+        glm::vec3 a = reference.acceleration(i);
+        double e = glm::length(test.acceleration(i) - a) / std::max(glm::length(a), 1e-20f);
+        error.rms += e * e;
+        error.max = std::max(error.max, e);
+    }
+    error.rms = std::sqrt(error.rms / std::max(n, 1));
+    return error;
+}
+
+static void printRow(const std::string& name, double seconds, double interactions, ForceError error){
+    std::cout << "  " << name;
+    for(size_t pad = name.size(); pad < 22; pad++) std::cout << ' ';
+    std::cout << seconds * 1e3 << " ms";
+    if (interactions > 0.0){
+        std::cout << ", " << interactions / seconds / 1e9 << " G interactions/s";
+    }
+    std::cout << ", rms err " << error.rms << ", max err " << error.max << "\n";
+}
+
+int benchGravity(const BenchArgs& args){
+
+    int numParticles = args.getInt("particles", 20000);
+    int threads = args.getInt("threads", 0);
+    float softening = (float)args.getDouble("softening", 2.0);
+    std::string thetas = args.getString("theta", "0.3,0.5,0.7");
+    std::string meshes = args.getString("mesh", "32,64");
+    std::string orders = args.getString("order", "2,3,4,5,6,8");
+    float fmmTheta = (float)args.getDouble("fmm-theta", 0.7);
+
+    ThreadPool pool(threads);
+
+    Simulation scene;
+    addCloudScene(scene, numParticles, 1.0f, 11);
+
+    std::vector<int> indices(numParticles);
+    for(int i = 0; i < numParticles; i++){
+        indices[i] = i;
+    }
+
+    std::cout << "particles: " << numParticles << ", threads: " << pool.size() << "\n";
+
+    DirectSummation direct;
+    direct.doubleAccumulation = true;
+    ParticleSystem reference = scene.particles;
+    direct.computeAccelerations(reference, indices, 1.0f, softening, pool);
+    printRow("direct (double)", direct.lastSeconds, (double)direct.lastInteractions, ForceError());
+
+    direct.doubleAccumulation = false;
+    ParticleSystem test = scene.particles;
+    direct.computeAccelerations(test, indices, 1.0f, softening, pool);
+    printRow("direct (float)", direct.lastSeconds, (double)direct.lastInteractions, compareForces(reference, test));
+
+    std::stringstream list(thetas);
+    std::string item;
+    while(std::getline(list, item, ',')){
+        BarnesHut tree;
+        tree.openingAngle = std::stof(item);
+
+        // the first call warms up the node pools
+        test = scene.particles;
+        tree.computeAccelerations(test, indices, 1.0f, softening, pool);
+        tree.computeAccelerations(test, indices, 1.0f, softening, pool);
+        printRow("barnes-hut theta " + item, tree.lastSeconds, (double)tree.lastInteractions, compareForces(reference, test));
+    }
+
+    std::stringstream meshList(meshes);
+    while(std::getline(meshList, item, ',')){
+        ParticleMesh mesh;
+        mesh.gridSize = std::stoi(item);
+
+        // the first call transforms the Green's function
+        test = scene.particles;
+        mesh.computeAccelerations(test, indices, 1.0f, softening, pool);
+        BenchTimer timer;
+        mesh.computeAccelerations(test, indices, 1.0f, softening, pool);
+        printRow("particle-mesh " + item + "^3", timer.seconds(), 0.0, compareForces(reference, test));
+    }
+
+    // error against wall time per expansion order, at a fixed opening angle
+    std::stringstream orderList(orders);
+    while(std::getline(orderList, item, ',')){
+        FastMultipole fmm;
+        fmm.expansionOrder = std::stoi(item);
+        fmm.openingAngle = fmmTheta;
+
+        test = scene.particles;
+        fmm.computeAccelerations(test, indices, 1.0f, softening, pool);
+        fmm.computeAccelerations(test, indices, 1.0f, softening, pool);
+        printRow("fmm order " + item, fmm.lastSeconds, 0.0, compareForces(reference, test));
+    }
+
+    return 0;
+}
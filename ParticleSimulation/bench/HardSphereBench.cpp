@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Scenes.h"
+#include "Simulation.h"
+
+/*
+ * Event-driven hard spheres against time-stepped collisions on a dilute gas.
+ *
+ * The gas flies without gravity and without damping, so kinetic energy
+ * should stay where it started. The event-driven run advances in frames
+ * of --frame seconds; the time-stepped runs (velocity swap on the uniform
+ * grid) take each of --rates steps per simulated second. For each run the
+ * report is the time per simulated second, the collisions per second and
+ * the relative change in kinetic energy after --seconds. For reference,
+ * kinetic theory gives a dilute gas N n pi d^2 <|v_i - v_j|> / 2
+ * collisions per second, with the mean relative speed sampled from the
+ * initial velocities.
+ */
+
+static void setUpGas(Simulation& sim, int numParticles, float radius, float speed, int threads){
+    sim.setThreadCount(threads);
+    sim.params.gConstant = 0.0f;
+    sim.params.damping = 1.0f;
+    sim.reorderInterval = 0;
+    addGasScene(sim, numParticles, radius, speed, 5);
+}
+
+static double gasEnergy(const ParticleSystem& ps){
+    double energy = 0.0;
+    for(int i = 0; i < (int)ps.size(); i++){
+        energy += 0.5 * ps.mass[i] * glm::dot(ps.velocity(i), ps.velocity(i));
+    }
+    return energy;
+}
+
+// Collisions per second kinetic theory expects of the gas as set up
+static double expectedCollisionRate(const Simulation& sim){
+    const ParticleSystem& ps = sim.particles;
+    int n = (int)ps.size();
+
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> pick(0, n - 1);
+    double relativeSpeed = 0.0;
+    const int samples = 200000;
+    for(int s = 0; s < samples; s++){
+        int i = pick(rng), j = pick(rng);
+        relativeSpeed += glm::length(ps.velocity(i) - ps.velocity(j));
+    }
+    relativeSpeed /= samples;
+
+    double diameter = 2.0 * ps.radius[0];
+    double reach = sim.params.boundaryRadius - ps.radius[0];
+    double density = n / (4.0 / 3.0 * M_PI * reach * reach * reach);
+    return 0.5 * n * density * M_PI * diameter * diameter * relativeSpeed;
+}
+
+int benchHardSpheres(const BenchArgs& args){
+
+    int numParticles = args.getInt("particles", 2000);
+    float radius = (float)args.getDouble("radius", 4.0);
+    float speed = (float)args.getDouble("speed", 200.0);
+    double seconds = args.getDouble("seconds", 10.0);
+    float frame = (float)args.getDouble("frame", 1.0 / 60.0);
+    int threads = args.getInt("threads", 0);
+    std::string rates = args.getString("rates", "60,240");
+
+    int numFrames = std::max((int)std::lround(seconds / frame), 1);
+
+    Simulation events;
+    setUpGas(events, numParticles, radius, speed, threads);
+    events.eventDriven = true;
+    double initialEnergy = gasEnergy(events.particles);
+
+    std::cout << numParticles << " particles of radius " << radius << " at " << speed << " units/s, "
+              << seconds << " s simulated; kinetic theory expects " << expectedCollisionRate(events) << " collisions/s\n";
+
+    BenchTimer eventTimer;
+    long long wallHits = 0, crossings = 0, stale = 0;
+    for(int f = 0; f < numFrames; f++){
+        events.step(frame);
+        wallHits += events.hardSpheres.lastWallHits;
+        crossings += events.hardSpheres.lastCrossings;
+        stale += events.hardSpheres.lastStale;
+    }
+    double eventSeconds = eventTimer.seconds();
+
+    std::cout << "  event-driven    " << eventSeconds * 1e3 / seconds << " ms per simulated s, "
+              << events.hardSpheres.totalCollisions / seconds << " collisions/s, kinetic energy "
+              << (gasEnergy(events.particles) / initialEnergy - 1.0) * 100.0 << "% off ("
+              << wallHits / seconds << " wall hits/s, " << crossings / seconds << " cell crossings/s, "
+              << stale / seconds << " stale events/s)\n";
+
+    std::stringstream rateList(rates);
+    std::string rate;
+    while(std::getline(rateList, rate, ',')){
+        int stepsPerSecond = std::stoi(rate);
+        int numSteps = std::max((int)std::lround(seconds * stepsPerSecond), 1);
+
+        Simulation stepped;
+        setUpGas(stepped, numParticles, radius, speed, threads);
+
+        BenchTimer timer;
+        long long contacts = 0;
+        for(int s = 0; s < numSteps; s++){
+            stepped.step(1.0f / stepsPerSecond);
+            contacts += stepped.lastContacts;
+        }
+        double steppedSeconds = timer.seconds();
+
+        std::string label = rate + " steps/s";
+        label.resize(std::max((int)label.size(), 16), ' ');
+        std::cout << "  " << label << steppedSeconds * 1e3 / seconds << " ms per simulated s, "
+                  << contacts / seconds << " collisions/s, kinetic energy "
+                  << (gasEnergy(stepped.particles) / initialEnergy - 1.0) * 100.0 << "% off\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include "Benchmarks.h"
+#include "ParticlePhysics.h"
+#include "Scenes.h"
+#include "SimdKernels.h"
+
+/*
+ * Throughput of VerletIntegrationRange against the per-particle
+ * VerletIntegration, and the largest deviation between the two after a
+ * single step from the same state (over many steps the orbits near the
+ * attractor are chaotic, so rounding differences grow without bound).
+ * Fails when the deviation exceeds --tolerance.
+ */
+
+// Largest |a - b| / max(|a|, 1) over every particle
+static double worstRelative(const ParticleSystem& a, const ParticleSystem& b, glm::vec3 (ParticleSystem::*field)(int) const){
+    double worst = 0.0;
+    for(int i = 0; i < (int)a.size(); i++){
+        glm::vec3 va = (a.*field)(i), vb = (b.*field)(i);
+        worst = std::max(worst, (double)glm::length(va - vb) / std::max(1.0f, glm::length(va)));
+    }
+    return worst;
+}
+
+int benchIntegration(const BenchArgs& args){
+
+    int numParticles = args.getInt("particles", 1 << 20);
+    int numSteps = args.getInt("steps", 20);
+    double tolerance = args.getDouble("tolerance", 1e-5);
+    float deltaTime = (float)args.getDouble("dt", 1.0 / 240.0);
+
+    Simulation scene;
+    addCloudScene(scene, numParticles, 1.0f, 7);
+
+    const SimParams& params = scene.params;
+
+    // accuracy: one step from identical state
+    ParticleSystem reference = scene.particles;
+    ParticleSystem vectorised = scene.particles;
+    for(int i = 0; i < numParticles; i++){
+        VerletIntegration(reference, i, deltaTime, params);
+    }
+    VerletIntegrationRange(vectorised, 0, numParticles, deltaTime, params);
+
+    double worstPosition = worstRelative(reference, vectorised, &ParticleSystem::position);
+    double worstVelocity = worstRelative(reference, vectorised, &ParticleSystem::velocity);
+    double worstAcceleration = worstRelative(reference, vectorised, &ParticleSystem::acceleration);
+
+    // throughput
+    BenchTimer scalarTimer;
+    for(int s = 0; s < numSteps; s++){
+        for(int i = 0; i < numParticles; i++){
+            VerletIntegration(reference, i, deltaTime, params);
+        }
+    }
+    double scalarSeconds = scalarTimer.seconds();
+
+    BenchTimer simdTimer;
+    for(int s = 0; s < numSteps; s++){
+        VerletIntegrationRange(vectorised, 0, numParticles, deltaTime, params);
+    }
+    double simdSeconds = simdTimer.seconds();
+
+    // 9 floats read and written per particle step
+    double bytes = 2.0 * 9.0 * sizeof(float) * numParticles * numSteps;
+    double updates = (double)numParticles * numSteps;
+
+    std::cout << "kernel ISA:            " << simdKernelISA() << " (" << simdKernelWidth() << " wide)\n"
+              << "particles x steps:     " << numParticles << " x " << numSteps << "\n"
+              << "scalar:                " << updates / scalarSeconds / 1e6 << " M particle-steps/s\n"
+              << "simd:                  " << updates / simdSeconds / 1e6 << " M particle-steps/s, "
+                                           << bytes / simdSeconds / 1e9 << " GB/s\n"
+              << "speedup:               " << scalarSeconds / simdSeconds << "x\n"
+              << "max rel. position err: " << worstPosition << "\n"
+              << "max rel. velocity err: " << worstVelocity << "\n"
+              << "max rel. accel. err:   " << worstAcceleration << "\n";
+
+    bool passed = worstPosition <= tolerance && worstVelocity <= tolerance && worstAcceleration <= tolerance;
+    std::cout << (passed ? "PASS" : "FAIL") << " (tolerance " << tolerance << ")" << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#include "PerfCounter.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+#include <cstdint>
+
+PerfCounter::PerfCounter(Event event){
+#ifdef __linux__
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    if (event == Event::CacheMisses){
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    }
+    else{
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    (void)event;
+#endif
+}
+
+PerfCounter::~PerfCounter(){
+#ifdef __linux__
+    if (fd >= 0){
+        close(fd);
+    }
+#endif
+}
+
+void PerfCounter::start(){
+#ifdef __linux__
+    if (fd >= 0){
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+long long PerfCounter::stop(){
+#ifdef __linux__
+    if (fd >= 0){
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t count = 0;
+        if (read(fd, &count, sizeof(count)) == (ssize_t)sizeof(count)){
+            return (long long)count;
+        }
+    }
+#endif
+    return -1;
+}
+
+std::string PerfCounter::format(long long count){
+    return count < 0 ? std::string("n/a") : std::to_string(count);
+}
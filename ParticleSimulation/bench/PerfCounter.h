@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+
+/*
+ * Hardware event counter for the benchmarks.
+ *
+ * Uses perf_event_open on Linux and counts the calling thread plus any
+ * thread it creates after the counter is opened, so open it before the
+ * ThreadPool it should cover. available() is false on other platforms
+ * and wherever the kernel refuses (no PMU in a VM, perf_event_paranoid).
+ */
+class PerfCounter{
+  public:
+    enum class Event { CacheMisses, L1DataReadMisses };
+
+    explicit PerfCounter(Event event);
+    ~PerfCounter();
+
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+    bool available() const { return fd >= 0; }
+
+    void start();
+    long long stop(); // events since start(), -1 if unavailable
+
+    // "1234" or "n/a"
+    static std::string format(long long count);
+
+  private:
+    int fd = -1;
+};
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Scenes.h"
+#include "Simulation.h"
+
+/*
+ * Broadphases on polydisperse scenes (a few boulders among many grains).
+ *
+ * For every radius ratio the overlapping pairs found through the
+ * hierarchical grid (its level grids plus the cross-level batches) are
+ * compared with those of a single uniform grid sized for the largest
+ * particle, on the initial scene and again after the hierarchical grid
+ * has stepped it; any difference fails the run. Each collision mode is
+ * stepped on the same scene and the time per step is reported.
+ */
+
+typedef std::vector<std::pair<int, int>> PairList;
+
+static void addIfOverlapping(const ParticleSystem& ps, int i, int j, PairList& out){
+    float dx = ps.px[i] - ps.px[j], dy = ps.py[i] - ps.py[j], dz = ps.pz[i] - ps.pz[j];
+    float contact = ps.radius[i] + ps.radius[j];
+    if (dx*dx + dy*dy + dz*dz < contact * contact){
+        out.push_back(std::make_pair(std::min(i, j), std::max(i, j)));
+    }
+}
+
+static PairList uniformGridContacts(const ParticleSystem& ps, const std::vector<int>& indices){
+    float maxRadius = 0.0f;
+    for(int i : indices){
+        maxRadius = std::max(maxRadius, ps.radius[i]);
+    }
+
+    SpatialGrid grid;
+    grid.build(indices, [&](int i){ return ps.position(i); }, maxRadius);
+
+    PairList contacts;
+    grid.forEachPair([&](int i, int j){ addIfOverlapping(ps, i, j, contacts); });
+    std::sort(contacts.begin(), contacts.end());
+    return contacts;
+}
+
+static PairList hierarchicalContacts(const HierarchicalGrid& hgrid, const ParticleSystem& ps){
+    PairList contacts;
+    for(int level = 0; level < hgrid.levelCount; level++){
+        hgrid.levels[level].grid.forEachPair([&](int i, int j){ addIfOverlapping(ps, i, j, contacts); });
+        for(int colour = 0; colour < SpatialGrid::numColours; colour++){
+            for(int k = 0; k < hgrid.crossBatchCount(level, colour); k++){
+                hgrid.forEachCrossPairInBatch(level, colour, k, [&](int i, int j){ addIfOverlapping(ps, i, j, contacts); });
+            }
+        }
+    }
+    std::sort(contacts.begin(), contacts.end());
+    return contacts;
+}
+
+// Compare the contact sets of both grids on the current state of sim
+static bool checkContacts(const Simulation& sim, int threads, const std::string& label){
+    std::vector<int> all(sim.particles.size());
+    for(int i = 0; i < (int)all.size(); i++){
+        all[i] = i;
+    }
+
+    ThreadPool pool(threads);
+    HierarchicalGrid hgrid;
+    hgrid.build(sim.particles, all, pool);
+
+    PairList expected = uniformGridContacts(sim.particles, all);
+    PairList found = hierarchicalContacts(hgrid, sim.particles);
+    bool match = expected == found;
+
+    std::cout << label << ": " << hgrid.levelCount << " levels, "
+              << expected.size() << " contacts, " << hgrid.lastCrossPairs << " cross-level candidates"
+              << (match ? "" : ", CONTACT SETS DIFFER (" + std::to_string(found.size()) + " found)") << "\n";
+    return match;
+}
+
+int benchPolydisperse(const BenchArgs& args){
+
+    int numParticles = args.getInt("particles", 50000);
+    int numSteps = args.getInt("steps", 50);
+    int threads = args.getInt("threads", 0);
+    float minRadius = (float)args.getDouble("radius", 1.0);
+    std::string ratios = args.getString("ratio", "10,100");
+    std::string modes = args.getString("modes", "grid,hgrid,sap,verlet");
+    const float deltaTime = 1.0f / 240.0f;
+
+    std::cout << "particles: " << numParticles << ", steps: " << numSteps << ", min radius: " << minRadius << "\n";
+
+    int failures = 0;
+
+    std::stringstream ratioList(ratios);
+    std::string ratio;
+    while(std::getline(ratioList, ratio, ',')){
+        float maxRadius = minRadius * std::stof(ratio);
+
+        Simulation initial;
+        addPolydisperseScene(initial, numParticles, minRadius, maxRadius, 11);
+        failures += checkContacts(initial, threads, "ratio " + ratio + ", initial") ? 0 : 1;
+
+        std::stringstream modeList(modes);
+        std::string mode;
+        while(std::getline(modeList, mode, ',')){
+            Simulation sim;
+            sim.setThreadCount(threads);
+            if (mode == "grid")        sim.collisionMode = CollisionMode::UniformGrid;
+            else if (mode == "hgrid")  sim.collisionMode = CollisionMode::HierarchicalGrid;
+            else if (mode == "sap")    sim.collisionMode = CollisionMode::SweepAndPrune;
+            else if (mode == "verlet") sim.collisionMode = CollisionMode::NeighbourList;
+            else{
+                std::cerr << "Unknown collision mode " << mode << "\n";
+                return 1;
+            }
+            addPolydisperseScene(sim, numParticles, minRadius, maxRadius, 11);
+
+            BenchTimer timer;
+            for(int s = 0; s < numSteps; s++){
+                sim.step(deltaTime);
+            }
+            double seconds = timer.seconds();
+
+            std::cout << "  " << mode << ": " << seconds * 1e3 / numSteps << " ms/step"
+                      << ", kinetic energy " << sim.kineticEnergy() << "\n";
+
+            // and once more on a state the hierarchical grid produced itself
+            if (sim.collisionMode == CollisionMode::HierarchicalGrid){
+                failures += checkContacts(sim, threads, "  after " + std::to_string(numSteps) + " steps") ? 0 : 1;
+            }
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
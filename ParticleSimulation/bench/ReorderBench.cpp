@@ -0,0 +1,92 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "PerfCounter.h"
+#include "Scenes.h"
+#include "Simulation.h"
+
+/*
+ * Effect of the periodic Morton reorder on step time and cache misses.
+ *
+ * A cloud scene starts in random memory order. It is stepped once per
+ * reorder interval (0 = never), and the time per step and hardware
+ * cache misses per step are reported, where the kernel exposes them.
+ * Afterwards the id -> index map is checked against the ids, so a
+ * reorder that loses track of a particle fails the run.
+ */
+
+static bool idsConsistent(const ParticleSystem& ps){
+    std::vector<char> seen(ps.size(), 0);
+    for(int k = 0; k < (int)ps.size(); k++){
+        int id = ps.id[k];
+        if (id < 0 || id >= (int)ps.size() || seen[id] || ps.indexOf(id) != k){
+            return false;
+        }
+        seen[id] = 1;
+    }
+    return true;
+}
+
+int benchReorder(const BenchArgs& args){
+
+    int numParticles = args.getInt("particles", 200000);
+    int numSteps = args.getInt("steps", 100);
+    int threads = args.getInt("threads", 0);
+    float radius = (float)args.getDouble("radius", 1.0);
+    std::string intervals = args.getString("interval", "0,64,16");
+    const float deltaTime = 1.0f / 240.0f;
+
+    std::cout << "particles: " << numParticles << ", steps: " << numSteps << "\n";
+
+    bool countersReported = false;
+    int failures = 0;
+
+    std::stringstream list(intervals);
+    std::string item;
+    while(std::getline(list, item, ',')){
+
+        // counters first, so they inherit the pool's worker threads
+        PerfCounter cacheMisses(PerfCounter::Event::CacheMisses);
+        PerfCounter l1Misses(PerfCounter::Event::L1DataReadMisses);
+
+        Simulation sim;
+        sim.setThreadCount(threads);
+        sim.reorderInterval = std::stoi(item);
+        addCloudScene(sim, numParticles, radius, 7);
+
+        if (!countersReported){
+            std::cout << "threads: " << sim.threadCount() << ", cache counters: "
+                      << (cacheMisses.available() ? "perf_event_open" : "unavailable") << "\n";
+            countersReported = true;
+        }
+
+        cacheMisses.start();
+        l1Misses.start();
+        BenchTimer timer;
+        for(int s = 0; s < numSteps; s++){
+            sim.step(deltaTime);
+        }
+        double seconds = timer.seconds();
+        long long misses = cacheMisses.stop();
+        long long l1 = l1Misses.stop();
+
+        BenchTimer reorderTimer;
+        sim.reorderParticles();
+        double reorderSeconds = reorderTimer.seconds();
+
+        bool consistent = idsConsistent(sim.particles);
+        failures += consistent ? 0 : 1;
+
+        std::cout << "  interval " << item
+                  << ": " << seconds * 1e3 / numSteps << " ms/step"
+                  << ", cache misses/step " << PerfCounter::format(misses < 0 ? -1 : misses / numSteps)
+                  << ", L1D read misses/step " << PerfCounter::format(l1 < 0 ? -1 : l1 / numSteps)
+                  << ", one reorder " << reorderSeconds * 1e3 << " ms"
+                  << (consistent ? "" : ", ID MAP BROKEN") << "\n";
+    }
+
+    return failures == 0 ? 0 : 1;
+}
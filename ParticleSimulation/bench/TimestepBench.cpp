@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "ParticlePhysics.h"
+#include "Scenes.h"
+#include "Simulation.h"
+#include "SplittingIntegrators.h"
+
+/*
+ * Block timesteps against global ones on eccentric orbits.
+ *
+ * Particles orbit the attractor in an open domain, small enough that
+ * they rarely touch, so each one's energy per unit mass should stay
+ * constant; the error left after --seconds of simulated time is what a
+ * step size costs in accuracy. Runs: one global step of dt / 2^levels
+ * (what every particle needs once the closest passes are resolved), one
+ * global step of dt, and block steps of dt with up to `levels` levels at
+ * each requested accuracy. The report is the time per simulated second,
+ * the Verlet updates per particle per step of dt, and the median and 99th
+ * percentile relative energy error. Every step also checks that each
+ * particle was integrated for exactly the step, whatever its levels did;
+ * the bench fails if one was not.
+ */
+
+// Specific energy in the attractor's field, the force clamped inside minGravityDistance
+static double orbitEnergy(const ParticleSystem& ps, int i, const SimParams& params){
+    double g = params.gConstant, r0 = params.minGravityDistance;
+    double d = glm::length(ps.position(i) - params.gravityCenter);
+    double potential = d >= r0 ? -g / d : -g / r0 + (d - r0) * g / (r0 * r0);
+    return 0.5 * glm::dot(ps.velocity(i), ps.velocity(i)) + potential;
+}
+
+struct EnergyError{
+    double median = 0.0;
+    double percentile99 = 0.0;
+};
+
+static EnergyError measureEnergyError(const Simulation& sim, const std::vector<double>& initial){
+    std::vector<double> errors;
+    for(int i = 0; i < (int)initial.size(); i++){
+        double energy = orbitEnergy(sim.particles, i, sim.params);
+        errors.push_back(std::abs(energy - initial[i]) / std::max(std::abs(initial[i]), 1e-12));
+    }
+
+    EnergyError error;
+    auto rank = errors.begin() + errors.size() / 2;
+    std::nth_element(errors.begin(), rank, errors.end());
+    error.median = *rank;
+    rank = errors.begin() + (errors.size() * 99) / 100;
+    std::nth_element(errors.begin(), rank, errors.end());
+    error.percentile99 = *rank;
+    return error;
+}
+
+int benchTimesteps(const BenchArgs& args){
+
+    int numParticles = args.getInt("particles", 2000);
+    double seconds = args.getDouble("seconds", 10.0);
+    float deltaTime = (float)args.getDouble("dt", 1.0 / 60.0);
+    int levels = std::min(std::max(args.getInt("levels", 6), 1), 16);
+    int threads = args.getInt("threads", 0);
+    std::string accuracies = args.getString("accuracy", "0.5,0.25,0.1");
+
+    std::cout << numParticles << " orbits, dt " << deltaTime << " s, " << seconds << " s simulated, up to "
+              << levels << " levels\n";
+
+    struct Run{
+        std::string label;
+        float deltaTime;
+        int maxLevel;
+        float accuracy;
+    };
+
+    std::vector<Run> runs;
+    runs.push_back({ "global dt/" + std::to_string(1 << levels), deltaTime / (float)(1 << levels), 0, 0.0f });
+    runs.push_back({ "global dt", deltaTime, 0, 0.0f });
+
+    std::stringstream accuracyList(accuracies);
+    std::string accuracy;
+    while(std::getline(accuracyList, accuracy, ',')){
+        runs.push_back({ "block " + accuracy, deltaTime, levels, std::stof(accuracy) });
+    }
+
+    bool timeMismatch = false;
+    for(const Run& run : runs){
+        Simulation sim;
+        sim.setThreadCount(threads);
+        sim.params.sphereBoundary = false;
+        sim.collisionMode = CollisionMode::HashGrid;
+        sim.reorderInterval = 0;
+        sim.maxTimestepLevel = run.maxLevel;
+        sim.timestepAccuracy = run.accuracy;
+        addOrbitScene(sim, numParticles, 0.1f, 11);
+
+        std::vector<double> initial(numParticles);
+        for(int i = 0; i < numParticles; i++){
+            initial[i] = orbitEnergy(sim.particles, i, sim.params);
+        }
+
+        int numSteps = std::max((int)std::lround(seconds / run.deltaTime), 1);
+        double updates = 0.0;
+        double mismatch = 0.0;
+
+        BenchTimer timer;
+        for(int s = 0; s < numSteps; s++){
+            sim.step(run.deltaTime);
+            updates += sim.lastUpdatesPerParticle;
+            mismatch = std::max(mismatch, sim.lastTimeMismatch);
+        }
+        double elapsed = timer.seconds();
+
+        // per step of dt, so the global runs read 2^levels and 1
+        double updatesPerStep = updates / numSteps * (deltaTime / run.deltaTime);
+        EnergyError error = measureEnergyError(sim, initial);
+
+        std::string label = run.label;
+        label.resize(std::max((int)label.size(), 14), ' ');
+        std::cout << "  " << label << elapsed * 1e3 / (numSteps * run.deltaTime) << " ms per simulated s, "
+                  << updatesPerStep << " updates per particle per dt"
+                  << ", energy error median " << error.median << " p99 " << error.percentile99 << "\n";
+
+        if (mismatch > 1e-6 * run.deltaTime){
+            std::cout << "  " << run.label << ": a particle was integrated for " << mismatch
+                      << " s more or less than a step\n";
+            timeMismatch = true;
+        }
+    }
+
+    return timeMismatch ? 1 : 0;
+}
+
+/*
+ * Splitting integrators on the same orbits.
+ *
+ * Each of --schemes runs at each of --dt with one global step, and the
+ * report is the force evaluations per particle per simulated second, the
+ * time, and the median and 99th percentile energy error after --seconds.
+ * The accelerations are set from the attractor before the first step, so
+ * no scheme starts from the particles' default ones. Last comes the
+ * cheapest run of each scheme whose median error is below --target.
+ * Wisdom-Holman evaluates no forces here (the attractor is all in its
+ * Kepler drift), so its cheapest run is the one with the longest step.
+ * Each scheme's longest step runs again with a Morton reorder every
+ * --reorder steps, which must not cost the double state any accuracy.
+ */
+
+struct SchemeInfo{
+    const char* name;
+    Integrator integrator;
+    int evaluations;
+};
+
+static const SchemeInfo schemeInfos[] = {
+    { "verlet",     Integrator::Verlet,     forceEvaluations<Leapfrog>() },
+    { "leapfrog",   Integrator::Leapfrog,   forceEvaluations<Leapfrog>() },
+    { "forestruth", Integrator::ForestRuth, forceEvaluations<ForestRuth>() },
+    { "yoshida4",   Integrator::Yoshida4,   forceEvaluations<Yoshida4>() },
+    { "yoshida6",   Integrator::Yoshida6,   forceEvaluations<Yoshida6>() },
+    { "omelyan",    Integrator::Omelyan,    forceEvaluations<Omelyan>() },
+    { "wisdomholman", Integrator::WisdomHolman, 0 },
+};
+
+int benchIntegrators(const BenchArgs& args){
+
+    int numParticles = args.getInt("particles", 2000);
+    double seconds = args.getDouble("seconds", 10.0);
+    double target = args.getDouble("target", 3e-7);
+    int threads = args.getInt("threads", 0);
+    std::string schemes = args.getString("schemes", "verlet,leapfrog,forestruth,yoshida4,yoshida6,omelyan,wisdomholman");
+    std::string steps = args.getString("dt", "0.25,0.1,0.0333,0.0167,0.0083,0.0042,0.0021");
+    int reorder = args.getInt("reorder", 4);
+
+    std::cout << numParticles << " orbits, " << seconds << " s simulated, target median energy error " << target << "\n";
+
+    std::stringstream schemeList(schemes);
+    std::string name;
+    std::vector<std::string> summary;
+    while(std::getline(schemeList, name, ',')){
+        const SchemeInfo* scheme = nullptr;
+        for(const SchemeInfo& info : schemeInfos){
+            if (name == info.name) scheme = &info;
+        }
+        if (!scheme){
+            std::cerr << "unknown scheme " << name << "\n";
+            return 1;
+        }
+
+        // one run at deltaTime, reordering every reorderInterval steps
+        auto run = [&](const std::string& label, float deltaTime, int reorderInterval){
+            Simulation sim;
+            sim.setThreadCount(threads);
+            sim.params.sphereBoundary = false;
+            sim.collisionMode = CollisionMode::HashGrid;
+            sim.reorderInterval = reorderInterval;
+            sim.integrator = scheme->integrator;
+            addOrbitScene(sim, numParticles, 0.1f, 11);
+
+            std::vector<double> initial(numParticles);
+            for(int i = 0; i < numParticles; i++){
+                initial[i] = orbitEnergy(sim.particles, i, sim.params);
+                sim.particles.setAcceleration(i, glm::vec3(0.0f));
+                SetGravity(sim.particles, i, sim.params);
+            }
+
+            int numSteps = std::max((int)std::lround(seconds / deltaTime), 1);
+            BenchTimer timer;
+            for(int s = 0; s < numSteps; s++){
+                sim.step(deltaTime);
+            }
+            double elapsed = timer.seconds();
+
+            // measureEnergyError goes by index, and a reorder moves the particles
+            if (reorderInterval > 0){
+                std::vector<double> byIndex(numParticles);
+                for(int i = 0; i < numParticles; i++){
+                    byIndex[sim.particles.indexOf(i)] = initial[i];
+                }
+                initial.swap(byIndex);
+            }
+            EnergyError error = measureEnergyError(sim, initial);
+
+            std::string padded = label;
+            padded.resize(std::max((int)padded.size() + 1, 20), ' ');
+            std::cout << "  " << padded << scheme->evaluations / deltaTime << " forces per particle per s, "
+                      << elapsed * 1e3 / (numSteps * deltaTime) << " ms per simulated s"
+                      << ", energy error median " << error.median << " p99 " << error.percentile99 << "\n";
+            return error;
+        };
+
+        double cheapest = -1.0, cheapestSteps = 0.0;
+        std::stringstream stepList(steps);
+        std::string step, longest;
+        while(std::getline(stepList, step, ',')){
+            float deltaTime = std::stof(step);
+            if (longest.empty() || deltaTime > std::stof(longest)){
+                longest = step;
+            }
+
+            double evaluations = scheme->evaluations / deltaTime;
+            EnergyError error = run(name + " " + step, deltaTime, 0);
+            if (error.median < target && (cheapest < 0.0 || evaluations < cheapest || (evaluations == cheapest && 1.0 / deltaTime < cheapestSteps))){
+                cheapest = evaluations;
+                cheapestSteps = 1.0 / deltaTime;
+            }
+        }
+        if (reorder > 0 && !longest.empty()){
+            run(name + " " + longest + " reorder " + std::to_string(reorder), std::stof(longest), reorder);
+        }
+
+        std::stringstream line;
+        line << "  " << name << ": ";
+        if (cheapest < 0.0){
+            line << "target not reached";
+        }
+        else{
+            line << std::lround(cheapest) << " forces per particle per s, " << cheapestSteps << " steps per s";
+        }
+        summary.push_back(line.str());
+    }
+
+    std::cout << "cheapest run below the target:\n";
+    for(const std::string& line : summary){
+        std::cout << line << "\n";
+    }
+    return 0;
+}
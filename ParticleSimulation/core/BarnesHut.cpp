@@ -0,0 +1,111 @@
+#include "BarnesHut.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+void BarnesHut::computeAccelerations(ParticleSystem& ps, const std::vector<int>& indices, float G, float softening, ThreadPool& pool){
+    auto start = std::chrono::steady_clock::now();
+
+    tree.build(ps, indices, pool);
+
+    const std::vector<OctreeNode>& nodes = tree.nodes;
+    if (nodes.empty()){
+        return;
+    }
+
+    const float* sortedX = tree.sortedX.data();
+    const float* sortedY = tree.sortedY.data();
+    const float* sortedZ = tree.sortedZ.data();
+    const float* sortedMass = tree.sortedMass.data();
+    const int* order = tree.order.data();
+
+    // a particle meets itself in its own leaf; any eps2 > 0 makes that term zero
+    const float eps2 = std::max(softening * softening, 1e-12f);
+
+    leaves.clear();
+    for(int k = 0; k < (int)nodes.size(); k++){
+        if (nodes[k].childCount == 0){
+            leaves.push_back(k);
+        }
+    }
+
+    if ((int)threadLists.size() < pool.size()){
+        threadLists.resize(pool.size());
+    }
+    for(InteractionList& list : threadLists){
+        list.interactions = 0;
+    }
+
+    // One walk per leaf bucket: a node is accepted for the whole bucket
+    // when size < theta * (distance - bucket radius), otherwise opened.
+    pool.parallelForThreads(0, (int)leaves.size(), 16, [&](int first, int last, int thread){
+        InteractionList& list = threadLists[thread];
+
+        for(int l = first; l < last; l++){
+            const OctreeNode& leaf = nodes[leaves[l]];
+
+            // bounding sphere of the bucket
+            float cx = 0.0f, cy = 0.0f, cz = 0.0f;
+            for(int s = leaf.begin; s < leaf.end; s++){
+                cx += sortedX[s]; cy += sortedY[s]; cz += sortedZ[s];
+            }
+            float invCount = 1.0f / (float)(leaf.end - leaf.begin);
+            cx *= invCount; cy *= invCount; cz *= invCount;
+
+            float bucketRadius = 0.0f;
+            for(int s = leaf.begin; s < leaf.end; s++){
+                float dx = sortedX[s] - cx, dy = sortedY[s] - cy, dz = sortedZ[s] - cz;
+                bucketRadius = std::max(bucketRadius, std::sqrt(dx*dx + dy*dy + dz*dz));
+            }
+
+            // gather accepted cells and the particles of opened leaves
+            list.clear();
+            list.stack.push_back(0);
+
+            while(!list.stack.empty()){
+                int index = list.stack.back();
+                list.stack.pop_back();
+                const OctreeNode& node = nodes[index];
+
+                float dx = node.comX - cx, dy = node.comY - cy, dz = node.comZ - cz;
+                float distance = std::sqrt(dx*dx + dy*dy + dz*dz) - bucketRadius;
+
+                if (distance > 0.0f && node.size < openingAngle * distance){
+                    list.add(node.comX, node.comY, node.comZ, node.mass);
+                }
+                else if (node.childCount == 0){
+                    for(int k = node.begin; k < node.end; k++){
+                        list.add(sortedX[k], sortedY[k], sortedZ[k], sortedMass[k]);
+                    }
+                }
+                else{
+                    for(int c = 0; c < node.childCount; c++){
+                        list.stack.push_back(node.firstChild + c);
+                    }
+                }
+            }
+
+            // evaluate the shared list for every particle of the bucket
+            int count = (int)list.x.size();
+            list.interactions += (long long)count * (leaf.end - leaf.begin);
+            for(int s = leaf.begin; s < leaf.end; s++){
+                float ax = 0.0f, ay = 0.0f, az = 0.0f;
+                accumulateGravity(list.x.data(), list.y.data(), list.z.data(), list.mass.data(), count,
+                                  sortedX[s], sortedY[s], sortedZ[s], eps2, ax, ay, az);
+
+                int i = order[s];
+                ps.ax[i] = G * ax;
+                ps.ay[i] = G * ay;
+                ps.az[i] = G * az;
+            }
+        }
+    });
+
+    lastInteractions = 0;
+    for(const InteractionList& list : threadLists){
+        lastInteractions += list.interactions;
+    }
+    lastSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
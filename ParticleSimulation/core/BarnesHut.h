@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Octree.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+#include <vector>
+
+/*
+ * Barnes-Hut octree for mutual (N-body) gravity.
+ *
+ * The octree (see Octree.h) is rebuilt every step. Forces are evaluated
+ * per leaf bucket: one tree walk builds an interaction list shared by
+ * all particles in the leaf. A node is used as a point mass when
+ * size < openingAngle * (distance - bucket radius).
+ * Forces are Plummer-softened: G m r / (r^2 + softening^2)^(3/2).
+ */
+
+class BarnesHut{
+  public:
+    float openingAngle = 0.5f;
+
+    // particle-source interactions and wall time of the last force pass
+    long long lastInteractions = 0;
+    double lastSeconds = 0.0;
+
+    // tree of the last force pass
+    Octree tree;
+
+    // Overwrite ps.ax/ay/az of the listed particles with their mutual gravity
+    void computeAccelerations(ParticleSystem& ps, const std::vector<int>& indices, float G, float softening, ThreadPool& pool);
+
+  private:
+    // per-thread walk scratch, reused between steps. Accepted cells and
+    // the particles of opened leaves share one SoA source list.
+    struct InteractionList{
+      std::vector<float> x, y, z, mass;
+      std::vector<int> stack;
+      long long interactions = 0;
+
+      void clear(){ x.clear(); y.clear(); z.clear(); mass.clear(); stack.clear(); }
+      void add(float px, float py, float pz, float m){ x.push_back(px); y.push_back(py); z.push_back(pz); mass.push_back(m); }
+    };
+
+    std::vector<int> leaves;
+    std::vector<InteractionList> threadLists;
+};
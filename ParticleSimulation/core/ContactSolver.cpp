@@ -0,0 +1,209 @@
+#include "ContactSolver.h"
+
+#include <algorithm>
+#include <cmath>
+
+// contacts (or particles) per parallel-for chunk
+static const int contactGrain = 1024;
+static const int particleGrain = 4096;
+
+void ContactSolver::begin(int threads){
+    threadLists.resize(threads);
+    for(ThreadList& list : threadLists){
+        list.pairs.clear();
+        list.candidates = 0;
+    }
+}
+
+void ContactSolver::colourContacts(int numParticles, ThreadPool& pool){
+    int indexBits = 1;
+    while((1 << indexBits) < numParticles){
+        indexBits++;
+    }
+
+    // sorted by pair, so the colouring does not depend on which thread found which contact
+    int count = (int)keys.size();
+    order.resize(count);
+    for(int k = 0; k < count; k++){
+        order[k] = k;
+    }
+    sorter.sort(keys, order, 32 + indexBits, pool);
+
+    // greedy: the lowest colour free at both particles
+    usedColours.resize(numParticles, 0);
+    contactColour.resize(count);
+    int colourCounts[maxColours + 1] = {};
+    for(int k = 0; k < count; k++){
+        int i = (int)(keys[k] >> 32), j = (int)(keys[k] & 0xffffffffu);
+        uint64_t used = usedColours[i] | usedColours[j];
+
+        int colour = 0;
+        while(colour < maxColours && ((used >> colour) & 1)){
+            colour++;
+        }
+        if (colour < maxColours){
+            usedColours[i] |= (uint64_t)1 << colour;
+            usedColours[j] |= (uint64_t)1 << colour;
+        }
+
+        contactColour[k] = colour;
+        colourCounts[colour]++;
+    }
+
+    numColours = 0;
+    colourStart.assign(maxColours + 2, 0);
+    for(int colour = 0; colour <= maxColours; colour++){
+        colourStart[colour + 1] = colourStart[colour] + colourCounts[colour];
+        if (colourCounts[colour] > 0){
+            numColours = colour + 1;
+        }
+    }
+
+    // group by colour, keeping the pair order within each
+    contacts.resize(count);
+    std::vector<int>& cursor = order;
+    cursor.assign(colourStart.begin(), colourStart.end() - 1);
+    for(int k = 0; k < count; k++){
+        int i = (int)(keys[k] >> 32), j = (int)(keys[k] & 0xffffffffu);
+        contacts[cursor[contactColour[k]]++] = Contact{ i, j, 0.0f, 0.0f };
+        usedColours[i] = 0;
+        usedColours[j] = 0;
+    }
+}
+
+template <typename ContactFn>
+void ContactSolver::sweep(ThreadPool& pool, ContactFn fn){
+    for(int colour = 0; colour < numColours; colour++){
+        int begin = colourStart[colour], end = colourStart[colour + 1];
+
+        // the overflow batch may share particles
+        if (colour == maxColours){
+            for(int k = begin; k < end; k++){
+                fn(k);
+            }
+            continue;
+        }
+
+        pool.parallelFor(begin, end, contactGrain, [&](int chunkBegin, int chunkEnd){
+            for(int k = chunkBegin; k < chunkEnd; k++){
+                fn(k);
+            }
+        });
+    }
+}
+
+void ContactSolver::solve(ParticleSystem& ps, const std::vector<int>& indices, float deltaTime, ThreadPool& pool){
+
+    keys.clear();
+    lastCandidates = 0;
+    for(const ThreadList& list : threadLists){
+        keys.insert(keys.end(), list.pairs.begin(), list.pairs.end());
+        lastCandidates += list.candidates;
+    }
+
+    colourContacts((int)ps.size(), pool);
+    if (contacts.empty()){
+        return;
+    }
+
+    // unit normal from i to j, false for coincident centres
+    auto normalOf = [&](int i, int j, glm::vec3& normal, float& distance){
+        normal = ps.position(j) - ps.position(i);
+        distance = glm::length(normal);
+        if (distance <= 0.0f){
+            return false;
+        }
+        normal /= distance;
+        return true;
+    };
+
+    // Restitution targets from the velocities before the solve. Pairs
+    // approaching slower than gravity builds up in a step are resting.
+    pool.parallelFor(0, (int)contacts.size(), contactGrain, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            Contact& c = contacts[k];
+            c.lambda = 0.0f;
+            c.targetSpeed = 0.0f;
+
+            glm::vec3 normal;
+            float distance;
+            if (!normalOf(c.i, c.j, normal, distance)){
+                continue;
+            }
+
+            float approach = -glm::dot(ps.velocity(c.j) - ps.velocity(c.i), normal);
+            float resting = deltaTime * (glm::length(ps.acceleration(c.i)) + glm::length(ps.acceleration(c.j)));
+            if (approach > resting){
+                c.targetSpeed = restitution * approach;
+            }
+        }
+    });
+
+    int numActive = (int)indices.size();
+    startX.resize(ps.size());
+    startY.resize(ps.size());
+    startZ.resize(ps.size());
+    pool.parallelFor(0, numActive, particleGrain, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            int i = indices[k];
+            startX[i] = ps.px[i];
+            startY[i] = ps.py[i];
+            startZ[i] = ps.pz[i];
+        }
+    });
+
+    // position projection
+    float alpha = compliance / (deltaTime * deltaTime);
+    for(int iteration = 0; iteration < iterations; iteration++){
+        sweep(pool, [&](int k){
+            Contact& c = contacts[k];
+            glm::vec3 normal;
+            float distance;
+            if (!normalOf(c.i, c.j, normal, distance)){
+                return;
+            }
+
+            float wi = 1.0f / ps.mass[c.i], wj = 1.0f / ps.mass[c.j];
+            float violation = distance - (ps.radius[c.i] + ps.radius[c.j]);
+
+            // XPBD update, clamped so the accumulated multiplier never pulls
+            float deltaLambda = (-violation - alpha * c.lambda) / (wi + wj + alpha);
+            deltaLambda = std::max(deltaLambda, -c.lambda);
+            if (deltaLambda == 0.0f){
+                return;
+            }
+            c.lambda += deltaLambda;
+
+            ps.setPosition(c.i, ps.position(c.i) - normal * (wi * deltaLambda));
+            ps.setPosition(c.j, ps.position(c.j) + normal * (wj * deltaLambda));
+        });
+    }
+
+    // the correction becomes velocity
+    float invDt = 1.0f / deltaTime;
+    pool.parallelFor(0, numActive, particleGrain, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            int i = indices[k];
+            ps.vx[i] += (ps.px[i] - startX[i]) * invDt;
+            ps.vy[i] += (ps.py[i] - startY[i]) * invDt;
+            ps.vz[i] += (ps.pz[i] - startZ[i]) * invDt;
+        }
+    });
+
+    // velocity pass: contacts that pushed separate at their target speed
+    sweep(pool, [&](int k){
+        const Contact& c = contacts[k];
+        glm::vec3 normal;
+        float distance;
+        if (c.lambda <= 0.0f || !normalOf(c.i, c.j, normal, distance)){
+            return;
+        }
+
+        float wi = 1.0f / ps.mass[c.i], wj = 1.0f / ps.mass[c.j];
+        float normalSpeed = glm::dot(ps.velocity(c.j) - ps.velocity(c.i), normal);
+        float impulse = (c.targetSpeed - normalSpeed) / (wi + wj);
+
+        ps.setVelocity(c.i, ps.velocity(c.i) - normal * (wi * impulse));
+        ps.setVelocity(c.j, ps.velocity(c.j) + normal * (wj * impulse));
+    });
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "ParticleSystem.h"
+#include "RadixSort.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+/*
+ * XPBD contact solver, the alternative to Particle3DCollision's one-shot
+ * velocity swap.
+ *
+ * Candidate pairs that touch, or come within `margin` of touching, become
+ * constraints C = |x_j - x_i| - (r_i + r_j) >= 0. Each step then
+ *   1. projects positions in `iterations` sweeps over the contacts, every
+ *      pair pushed apart in proportion to the inverse masses, softened by
+ *      the compliance (0 = rigid) as in XPBD;
+ *   2. adds the total correction of each particle to its velocity
+ *      (v += dx / dt), and
+ *   3. sets the normal velocity of every contact that pushed to
+ *      restitution times the approach speed it had before the solve, or
+ *      to zero for resting contacts, so the correction does not launch
+ *      the particles apart.
+ * More iterations leave less overlap in deep stacks, at a linear cost.
+ *
+ * Contacts are sorted by particle pair and greedily graph-coloured so no
+ * two contacts of a colour share a particle. Each colour is swept in
+ * parallel without locks and the result does not depend on the thread
+ * count. Contacts that would need more than maxColours colours go into
+ * one more batch, swept serially.
+ */
+class ContactSolver{
+  public:
+    static const int maxColours = 64;
+
+    int iterations = 4;
+    float compliance = 0.0f;    // inverse stiffness, 0 = rigid
+    float restitution = 0.5f;
+    float margin = 0.05f;       // pairs closer than (1 + margin)(r_i + r_j) become contacts
+
+    // statistics of the last step
+    long long lastCandidates = 0;
+    int contactCount() const { return (int)contacts.size(); }
+    int colourCount() const { return numColours; }
+
+    // Start a step's collection with one contact list per thread
+    void begin(int threads);
+
+    // Keep the pair (from any broadphase, on the given pool thread) if it is close enough
+    void addCandidate(const ParticleSystem& ps, int thread, int i, int j){
+      ThreadList& list = threadLists[thread];
+      list.candidates++;
+
+      float dx = ps.px[j] - ps.px[i], dy = ps.py[j] - ps.py[i], dz = ps.pz[j] - ps.pz[i];
+      float reach = (1.0f + margin) * (ps.radius[i] + ps.radius[j]);
+      if (dx*dx + dy*dy + dz*dz < reach * reach){
+        uint64_t a = (uint64_t)(i < j ? i : j), b = (uint64_t)(i < j ? j : i);
+        list.pairs.push_back((a << 32) | b);
+      }
+    }
+
+    // Visit the contacts that pushed in the last solve
+    template <typename PairFn>
+    void forEachTouching(PairFn visit) const {
+      for(const Contact& c : contacts){
+        if (c.lambda > 0.0f) visit(c.i, c.j);
+      }
+    }
+
+    // Colour the collected contacts and solve them; indices are the
+    // particles that moved this step, whose velocities take the correction
+    void solve(ParticleSystem& ps, const std::vector<int>& indices, float deltaTime, ThreadPool& pool);
+
+  private:
+    struct ThreadList{
+      std::vector<uint64_t> pairs;
+      long long candidates = 0;
+    };
+
+    struct Contact{
+      int i, j;
+      float lambda;          // accumulated multiplier, >= 0 (contacts only push)
+      float targetSpeed;     // normal separation speed after the velocity pass
+    };
+
+    std::vector<ThreadList> threadLists;
+
+    // merged pair keys, sorted, and the contacts grouped by colour
+    std::vector<uint64_t> keys;
+    std::vector<int> order;
+    std::vector<int> contactColour;
+    std::vector<Contact> contacts;
+    std::vector<int> colourStart;
+    int numColours = 0;
+    RadixSorter sorter;
+
+    // colours taken at each particle while colouring
+    std::vector<uint64_t> usedColours;
+
+    // positions before the projection
+    std::vector<float> startX, startY, startZ;
+
+    void colourContacts(int numParticles, ThreadPool& pool);
+
+    // fn(k) for every contact, colour by colour, each colour in parallel
+    template <typename ContactFn>
+    void sweep(ThreadPool& pool, ContactFn fn);
+};
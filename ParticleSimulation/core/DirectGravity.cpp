@@ -0,0 +1,75 @@
+#include "DirectGravity.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <chrono>
+
+// upper bound on targetBlock, sizes the per-block accumulators
+static const int maxTargetBlock = 256;
+
+void DirectSummation::computeAccelerations(ParticleSystem& ps, const std::vector<int>& indices, float G, float softening, ThreadPool& pool){
+    auto start = std::chrono::steady_clock::now();
+
+    int n = (int)indices.size();
+
+    // a particle meets itself in the sum; any eps2 > 0 makes that term zero
+    const float eps2 = std::max(softening * softening, 1e-12f);
+
+    // gather the sources contiguously
+    x.resize(n); y.resize(n); z.resize(n); mass.resize(n);
+    pool.parallelFor(0, n, 4096, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            int i = indices[k];
+            x[k] = ps.px[i]; y[k] = ps.py[i]; z[k] = ps.pz[i];
+            mass[k] = ps.mass[i];
+        }
+    });
+
+    int block = std::max(1, std::min(targetBlock, maxTargetBlock));
+    int numBlocks = (n + block - 1) / block;
+
+    pool.parallelFor(0, numBlocks, 1, [&](int firstBlock, int lastBlock){
+        double sumX[maxTargetBlock], sumY[maxTargetBlock], sumZ[maxTargetBlock];
+
+        for(int b = firstBlock; b < lastBlock; b++){
+            int begin = b * block;
+            int end = std::min(n, begin + block);
+
+            std::fill(sumX, sumX + (end - begin), 0.0);
+            std::fill(sumY, sumY + (end - begin), 0.0);
+            std::fill(sumZ, sumZ + (end - begin), 0.0);
+
+            // each source tile is reused by every target of the block
+            for(int tile = 0; tile < n; tile += tileSize){
+                int count = std::min(tileSize, n - tile);
+
+                for(int t = begin; t < end; t++){
+                    float ax = 0.0f, ay = 0.0f, az = 0.0f;
+                    accumulateGravity(&x[tile], &y[tile], &z[tile], &mass[tile], count,
+                                      x[t], y[t], z[t], eps2, ax, ay, az);
+
+                    if (doubleAccumulation){
+                        sumX[t - begin] += ax;
+                        sumY[t - begin] += ay;
+                        sumZ[t - begin] += az;
+                    }
+                    else{
+                        sumX[t - begin] = (float)sumX[t - begin] + ax;
+                        sumY[t - begin] = (float)sumY[t - begin] + ay;
+                        sumZ[t - begin] = (float)sumZ[t - begin] + az;
+                    }
+                }
+            }
+
+            for(int t = begin; t < end; t++){
+                int i = indices[t];
+                ps.ax[i] = (float)(G * sumX[t - begin]);
+                ps.ay[i] = (float)(G * sumY[t - begin]);
+                ps.az[i] = (float)(G * sumZ[t - begin]);
+            }
+        }
+    });
+
+    lastInteractions = (long long)n * n;
+    lastSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
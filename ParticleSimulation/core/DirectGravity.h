@@ -0,0 +1,36 @@
+#pragma once
+
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+#include <vector>
+
+/*
+ * Exact O(N^2) pairwise gravity by direct summation.
+ *
+ * Meant for validation and for mid-sized runs (10^3 - 10^5 bodies) where
+ * tree approximation error is not acceptable. Sources are walked in
+ * tiles of tileSize particles (sized to stay in L1), each tile feeding a
+ * block of targets through the SIMD accumulateGravity kernel. Per-tile
+ * partial sums can be accumulated in double to keep rounding error from
+ * growing with N.
+ */
+class DirectSummation{
+  public:
+    int tileSize = 1024;
+    int targetBlock = 64; // at most 256
+    bool doubleAccumulation = false;
+
+    // pair interactions and wall time of the last call
+    long long lastInteractions = 0;
+    double lastSeconds = 0.0;
+
+    double interactionsPerSecond() const {
+      return lastSeconds > 0.0 ? lastInteractions / lastSeconds : 0.0;
+    }
+
+    // Overwrite ps.ax/ay/az of the listed particles with their mutual gravity
+    void computeAccelerations(ParticleSystem& ps, const std::vector<int>& indices, float G, float softening, ThreadPool& pool);
+
+  private:
+    std::vector<float> x, y, z, mass;
+};
@@ -0,0 +1,129 @@
+#include "FFT.h"
+
+#include <algorithm>
+#include <cmath>
+
+void FFTPlan::prepare(int n){
+    if (n == size){
+        return;
+    }
+    size = n;
+
+    int bits = 0;
+    while((1 << bits) < n){
+        bits++;
+    }
+
+    bitReverse.resize(n);
+    for(int i = 0; i < n; i++){
+        int r = 0;
+        for(int b = 0; b < bits; b++){
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bitReverse[i] = r;
+    }
+
+    // e^(-2 pi i k / n) for k < n/2, computed in double
+    twiddles.resize(n / 2);
+    for(int k = 0; k < n / 2; k++){
+        double angle = -2.0 * M_PI * k / n;
+        twiddles[k] = Complex((float)std::cos(angle), (float)std::sin(angle));
+    }
+}
+
+void FFTPlan::transform(Complex* data, bool inverse) const {
+    int n = size;
+
+    for(int i = 0; i < n; i++){
+        int j = bitReverse[i];
+        if (j > i){
+            std::swap(data[i], data[j]);
+        }
+    }
+
+    // iterative Cooley-Tukey butterflies
+    for(int length = 2; length <= n; length <<= 1){
+        int half = length / 2;
+        int step = n / length;
+
+        for(int start = 0; start < n; start += length){
+            for(int k = 0; k < half; k++){
+                Complex w = twiddles[k * step];
+                if (inverse){
+                    w = std::conj(w);
+                }
+
+                Complex a = data[start + k];
+                Complex b = data[start + k + half] * w;
+                data[start + k] = a + b;
+                data[start + k + half] = a - b;
+            }
+        }
+    }
+}
+
+// Transform the x lines with y < rows and z < slabs
+static void transformX(std::vector<Complex>& grid, const FFTPlan& plan, bool inverse, ThreadPool& pool, int rows, int slabs){
+    int n = plan.size;
+    pool.parallelFor(0, rows * slabs, 16, [&](int begin, int end){
+        for(int line = begin; line < end; line++){
+            int y = line % rows, z = line / rows;
+            plan.transform(&grid[((size_t)z * n + y) * n], inverse);
+        }
+    });
+}
+
+// Transform the strided lines along y (axis 1, for z < outerCount) or
+// z (axis 2, for y < outerCount). Eight neighbouring x columns are
+// gathered together so each cache line fetched is used in full.
+static void transformStrided(std::vector<Complex>& grid, const FFTPlan& plan, bool inverse, ThreadPool& pool, int axis, int outerCount){
+    const int columns = 8;
+    int n = plan.size;
+    size_t stride = axis == 1 ? (size_t)n : (size_t)n * n;
+    int groupsPerOuter = (n + columns - 1) / columns;
+
+    pool.parallelFor(0, outerCount * groupsPerOuter, 4, [&](int begin, int end){
+        std::vector<Complex> buffer((size_t)columns * n);
+
+        for(int group = begin; group < end; group++){
+            int outer = group / groupsPerOuter;
+            int x0 = (group % groupsPerOuter) * columns;
+            int width = std::min(columns, n - x0);
+            size_t base = axis == 1 ? (size_t)outer * n * n + x0 : (size_t)outer * n + x0;
+
+            for(int k = 0; k < n; k++){
+                for(int c = 0; c < width; c++){
+                    buffer[(size_t)c * n + k] = grid[base + k * stride + c];
+                }
+            }
+            for(int c = 0; c < width; c++){
+                plan.transform(&buffer[(size_t)c * n], inverse);
+            }
+            for(int k = 0; k < n; k++){
+                for(int c = 0; c < width; c++){
+                    grid[base + k * stride + c] = buffer[(size_t)c * n + k];
+                }
+            }
+        }
+    });
+}
+
+void fft3d(std::vector<Complex>& grid, const FFTPlan& plan, bool inverse, ThreadPool& pool, int octant){
+    int n = plan.size;
+    int m = octant > 0 ? octant : n;
+
+    if (!inverse){
+        // input is zero outside the octant: x lines only exist there, and
+        // after the x pass only slabs z < m are non-zero
+        transformX(grid, plan, false, pool, m, m);
+        transformStrided(grid, plan, false, pool, 1, m);
+        transformStrided(grid, plan, false, pool, 2, n);
+    }
+    else{
+        // only the octant is needed: z first over everything, then y for
+        // z < m, then x for y, z < m
+        transformStrided(grid, plan, true, pool, 2, n);
+        transformStrided(grid, plan, true, pool, 1, m);
+        transformX(grid, plan, true, pool, m, m);
+    }
+}
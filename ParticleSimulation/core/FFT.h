@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include <complex>
+#include <vector>
+
+/*
+ * Self-contained radix-2 complex FFT.
+ *
+ * FFTPlan holds the twiddle factors and bit-reversal table for one
+ * power-of-two length. fft3d transforms a cubic n^3 grid (x fastest) as
+ * three batches of 1D transforms, one per axis, with the lines of each
+ * batch spread over the thread pool. Inverse transforms are unscaled.
+ *
+ * For zero-padded convolutions, pass octant = m: a forward transform then
+ * assumes the input is zero outside [0, m)^3, and an inverse transform
+ * only produces correct values inside it. Lines that are all zero or not
+ * needed are skipped.
+ */
+
+using Complex = std::complex<float>;
+
+class FFTPlan{
+  public:
+    int size = 0;
+
+    void prepare(int n);
+
+    // In-place transform of `size` contiguous values
+    void transform(Complex* data, bool inverse) const;
+
+  private:
+    std::vector<Complex> twiddles;
+    std::vector<int> bitReverse;
+};
+
+// In-place 3D transform of an n*n*n grid, index (z * n + y) * n + x
+void fft3d(std::vector<Complex>& grid, const FFTPlan& plan, bool inverse, ThreadPool& pool, int octant = 0);
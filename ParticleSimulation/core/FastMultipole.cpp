@@ -0,0 +1,384 @@
+#include "FastMultipole.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+static double binomial(int n, int k){
+    double result = 1.0;
+    for(int i = 1; i <= k; i++){
+        result = result * (n - k + i) / i;
+    }
+    return result;
+}
+
+void FastMultipole::Expansion::prepare(int newOrder){
+    if (order == newOrder){
+        return;
+    }
+    order = newOrder;
+    int side = order + 1;
+
+    terms.clear();
+    index.assign(side * side * side, -1);
+    for(int degree = 0; degree <= order; degree++){
+        for(int a = degree; a >= 0; a--){
+            for(int b = degree - a; b >= 0; b--){
+                int c = degree - a - b;
+                index[(a * side + b) * side + c] = (int)terms.size();
+                terms.push_back({ a, b, c, degree });
+            }
+        }
+    }
+    int n = size();
+
+    parent.assign(n, -1);
+    axis.assign(n, 0);
+    minusOne.assign(3 * n, -1);
+    minusTwo.assign(3 * n, -1);
+    for(int k = 0; k < n; k++){
+        const Term& t = terms[k];
+        int e[3] = { t.a, t.b, t.c };
+        for(int i = 2; i >= 0; i--){
+            if (e[i] >= 1){
+                e[i]--;
+                minusOne[3 * k + i] = find(e[0], e[1], e[2]);
+                parent[k] = minusOne[3 * k + i];
+                axis[k] = i;
+                if (e[i] >= 1){
+                    e[i]--;
+                    minusTwo[3 * k + i] = find(e[0], e[1], e[2]);
+                    e[i]++;
+                }
+                e[i]++;
+            }
+        }
+    }
+
+    m2mStart.assign(n + 1, 0);
+    m2lStart.assign(n + 1, 0);
+    l2lStart.assign(n + 1, 0);
+    m2m.clear();
+    m2l.clear();
+    l2l.clear();
+
+    for(int k = 0; k < n; k++){
+        const Term& t = terms[k];
+
+        // M'_t = sum over s <= t of C(t, s) shift^(t-s) M_s
+        m2mStart[k] = (int)m2m.size();
+        for(int j = 0; j <= k; j++){
+            const Term& s = terms[j];
+            if (s.a <= t.a && s.b <= t.b && s.c <= t.c){
+                double coefficient = binomial(t.a, s.a) * binomial(t.b, s.b) * binomial(t.c, s.c);
+                m2m.push_back({ j, find(t.a - s.a, t.b - s.b, t.c - s.c), coefficient });
+            }
+        }
+
+        // L_t = sum over |s| <= order - |t| of (-1)^|s| C(s+t, t) M_s D_(s+t)
+        m2lStart[k] = (int)m2l.size();
+        for(int j = 0; j < n; j++){
+            const Term& s = terms[j];
+            if (s.degree + t.degree > order){
+                break;
+            }
+            double coefficient = binomial(s.a + t.a, t.a) * binomial(s.b + t.b, t.b) * binomial(s.c + t.c, t.c);
+            if (s.degree & 1){
+                coefficient = -coefficient;
+            }
+            m2l.push_back({ j, find(s.a + t.a, s.b + t.b, s.c + t.c), coefficient });
+        }
+
+        // L'_t = sum over s >= t of C(s, t) shift^(s-t) L_s
+        l2lStart[k] = (int)l2l.size();
+        for(int j = k; j < n; j++){
+            const Term& s = terms[j];
+            if (s.a >= t.a && s.b >= t.b && s.c >= t.c){
+                double coefficient = binomial(s.a, t.a) * binomial(s.b, t.b) * binomial(s.c, t.c);
+                l2l.push_back({ j, find(s.a - t.a, s.b - t.b, s.c - t.c), coefficient });
+            }
+        }
+    }
+    m2mStart[n] = (int)m2m.size();
+    m2lStart[n] = (int)m2l.size();
+    l2lStart[n] = (int)l2l.size();
+}
+
+// Monomials x^a y^b z^c of every term
+void FastMultipole::powersOf(double x, double y, double z, double* out) const {
+    const double coordinate[3] = { x, y, z };
+    out[0] = 1.0;
+    for(int k = 1; k < expansion.size(); k++){
+        out[k] = out[expansion.parent[k]] * coordinate[expansion.axis[k]];
+    }
+}
+
+// P2M for leaves, M2M from the children otherwise, recursing down to
+// the leaves or to the next subtree root
+void FastMultipole::upward(int node, WalkScratch& s){
+    const OctreeNode& n = tree.nodes[node];
+    int terms = expansion.size();
+    double* moments = &multipoles[(size_t)node * terms];
+    std::fill(moments, moments + terms, 0.0);
+    double* powers = s.powers.data();
+
+    if (n.childCount == 0){
+        for(int k = n.begin; k < n.end; k++){
+            powersOf((double)tree.sortedX[k] - n.comX, (double)tree.sortedY[k] - n.comY, (double)tree.sortedZ[k] - n.comZ, powers);
+            double m = tree.sortedMass[k];
+            for(int t = 0; t < terms; t++){
+                moments[t] += m * powers[t];
+            }
+        }
+        return;
+    }
+
+    for(int c = 0; c < n.childCount; c++){
+        int child = n.firstChild + c;
+        const OctreeNode& cn = tree.nodes[child];
+
+        // subtree roots already have their moments from the parallel pass
+        if (!tree.isSubtreeRoot(child)){
+            upward(child, s);
+        }
+
+        powersOf((double)cn.comX - n.comX, (double)cn.comY - n.comY, (double)cn.comZ - n.comZ, powers);
+        const double* childMoments = &multipoles[(size_t)child * terms];
+        for(int t = 0; t < terms; t++){
+            double sum = 0.0;
+            for(int e = expansion.m2mStart[t]; e < expansion.m2mStart[t + 1]; e++){
+                const ShiftEntry& entry = expansion.m2m[e];
+                sum += entry.coefficient * powers[entry.power] * childMoments[entry.source];
+            }
+            moments[t] += sum;
+        }
+    }
+}
+
+// Local expansion of `target` += far field of the moments of `source`
+void FastMultipole::multipoleToLocal(int target, int source, double eps2, WalkScratch& s){
+    const OctreeNode& a = tree.nodes[target];
+    const OctreeNode& b = tree.nodes[source];
+    int terms = expansion.size();
+
+    double rx = (double)a.comX - b.comX, ry = (double)a.comY - b.comY, rz = (double)a.comZ - b.comZ;
+    double u = rx*rx + ry*ry + rz*rz + eps2;
+    double invU = 1.0 / u;
+    const double r[3] = { rx, ry, rz };
+
+    // Taylor coefficients of (r^2 + eps^2)^(-1/2) at r, by the recurrence
+    // n u T_k = -(2n - 1) sum_i r_i T_(k - e_i) - (n - 1) sum_i T_(k - 2 e_i)
+    double* derivatives = s.derivatives.data();
+    derivatives[0] = std::sqrt(invU);
+    for(int k = 1; k < terms; k++){
+        int n = expansion.terms[k].degree;
+        double first = 0.0, second = 0.0;
+        for(int i = 0; i < 3; i++){
+            int one = expansion.minusOne[3 * k + i];
+            if (one >= 0){
+                first += r[i] * derivatives[one];
+            }
+            int two = expansion.minusTwo[3 * k + i];
+            if (two >= 0){
+                second += derivatives[two];
+            }
+        }
+        derivatives[k] = -((2 * n - 1) * first + (n - 1) * second) * invU / n;
+    }
+
+    const double* moments = &multipoles[(size_t)source * terms];
+    double* local = &locals[(size_t)target * terms];
+    for(int t = 0; t < terms; t++){
+        double sum = 0.0;
+        for(int e = expansion.m2lStart[t]; e < expansion.m2lStart[t + 1]; e++){
+            const ShiftEntry& entry = expansion.m2l[e];
+            sum += entry.coefficient * moments[entry.source] * derivatives[entry.power];
+        }
+        local[t] += sum;
+    }
+    s.cellInteractions++;
+}
+
+// Direct softened sum of the particles of `source` on those of `target`
+void FastMultipole::particleToParticle(int target, int source, float eps2, WalkScratch& s){
+    const OctreeNode& a = tree.nodes[target];
+    const OctreeNode& b = tree.nodes[source];
+    int count = b.end - b.begin;
+
+    for(int k = a.begin; k < a.end; k++){
+        accumulateGravity(&tree.sortedX[b.begin], &tree.sortedY[b.begin], &tree.sortedZ[b.begin], &tree.sortedMass[b.begin], count,
+                          tree.sortedX[k], tree.sortedY[k], tree.sortedZ[k], eps2, accX[k], accY[k], accZ[k]);
+    }
+    s.interactions += (long long)count * (a.end - a.begin);
+}
+
+// Dual tree walk of one target subtree against the whole tree
+void FastMultipole::walk(int target, float eps2, WalkScratch& s){
+    // overlapping cells must never be accepted, which theta < 1 guarantees
+    float theta = std::min(openingAngle, 0.95f);
+
+    // an M2L costs about this many multiply-adds; cheaper pairs are summed directly
+    long long m2lCost = (long long)expansion.m2l.size() + 3 * expansion.size();
+
+    s.stack.clear();
+    s.stack.push_back(target);
+    s.stack.push_back(0);
+
+    while(!s.stack.empty()){
+        int b = s.stack.back(); s.stack.pop_back();
+        int a = s.stack.back(); s.stack.pop_back();
+        const OctreeNode& na = tree.nodes[a];
+        const OctreeNode& nb = tree.nodes[b];
+
+        float dx = na.comX - nb.comX, dy = na.comY - nb.comY, dz = na.comZ - nb.comZ;
+        float reach = na.radius + nb.radius;
+        bool accepted = a != b && reach * reach < theta * theta * (dx*dx + dy*dy + dz*dz);
+        bool leaves = na.childCount == 0 && nb.childCount == 0;
+        long long pairs = (long long)(na.end - na.begin) * (nb.end - nb.begin);
+
+        if (accepted && pairs > m2lCost){
+            multipoleToLocal(a, b, eps2, s);
+        }
+        else if (accepted || leaves){
+            particleToParticle(a, b, eps2, s);
+        }
+        else if (nb.childCount == 0 || (na.childCount > 0 && na.radius > nb.radius)){
+            for(int c = 0; c < na.childCount; c++){
+                s.stack.push_back(na.firstChild + c);
+                s.stack.push_back(b);
+            }
+        }
+        else{
+            for(int c = 0; c < nb.childCount; c++){
+                s.stack.push_back(a);
+                s.stack.push_back(nb.firstChild + c);
+            }
+        }
+    }
+}
+
+// L2L into the children, L2P at the leaves, over a whole subtree
+void FastMultipole::downward(int node, WalkScratch& s){
+    const OctreeNode& n = tree.nodes[node];
+    int terms = expansion.size();
+    const double* local = &locals[(size_t)node * terms];
+    double* powers = s.powers.data();
+
+    if (n.childCount == 0){
+        // acceleration / G = gradient of the local expansion
+        for(int k = n.begin; k < n.end; k++){
+            powersOf((double)tree.sortedX[k] - n.comX, (double)tree.sortedY[k] - n.comY, (double)tree.sortedZ[k] - n.comZ, powers);
+            double g[3] = { 0.0, 0.0, 0.0 };
+            for(int t = 1; t < terms; t++){
+                const Term& term = expansion.terms[t];
+                const int exponent[3] = { term.a, term.b, term.c };
+                for(int i = 0; i < 3; i++){
+                    if (exponent[i] > 0){
+                        g[i] += exponent[i] * powers[expansion.minusOne[3 * t + i]] * local[t];
+                    }
+                }
+            }
+            accX[k] += (float)g[0];
+            accY[k] += (float)g[1];
+            accZ[k] += (float)g[2];
+        }
+        return;
+    }
+
+    for(int c = 0; c < n.childCount; c++){
+        int child = n.firstChild + c;
+        const OctreeNode& cn = tree.nodes[child];
+
+        powersOf((double)cn.comX - n.comX, (double)cn.comY - n.comY, (double)cn.comZ - n.comZ, powers);
+        double* childLocal = &locals[(size_t)child * terms];
+        for(int t = 0; t < terms; t++){
+            double sum = 0.0;
+            for(int e = expansion.l2lStart[t]; e < expansion.l2lStart[t + 1]; e++){
+                const ShiftEntry& entry = expansion.l2l[e];
+                sum += entry.coefficient * powers[entry.power] * local[entry.source];
+            }
+            childLocal[t] += sum;
+        }
+        downward(child, s);
+    }
+}
+
+void FastMultipole::computeAccelerations(ParticleSystem& ps, const std::vector<int>& indices, float G, float softening, ThreadPool& pool){
+    auto start = std::chrono::steady_clock::now();
+
+    tree.leafCapacity = leafCapacity;
+    tree.build(ps, indices, pool);
+
+    int numNodes = (int)tree.nodes.size();
+    int n = (int)indices.size();
+    if (numNodes == 0){
+        return;
+    }
+
+    expansion.prepare(std::max(1, std::min(expansionOrder, 8)));
+    int terms = expansion.size();
+
+    // a particle meets itself in its own leaf; any eps2 > 0 makes that term zero
+    const float eps2 = std::max(softening * softening, 1e-12f);
+
+    multipoles.resize((size_t)numNodes * terms);
+    locals.resize((size_t)numNodes * terms);
+    accX.resize(n); accY.resize(n); accZ.resize(n);
+
+    if ((int)scratch.size() < pool.size()){
+        scratch.resize(pool.size());
+    }
+    for(WalkScratch& s : scratch){
+        s.derivatives.resize(terms);
+        s.powers.resize(terms);
+        s.interactions = 0;
+        s.cellInteractions = 0;
+    }
+
+    pool.parallelFor(0, numNodes, 256, [&](int begin, int end){
+        std::fill(locals.begin() + (size_t)begin * terms, locals.begin() + (size_t)end * terms, 0.0);
+    });
+    pool.parallelFor(0, n, 4096, [&](int begin, int end){
+        std::fill(accX.begin() + begin, accX.begin() + end, 0.0f);
+        std::fill(accY.begin() + begin, accY.begin() + end, 0.0f);
+        std::fill(accZ.begin() + begin, accZ.begin() + end, 0.0f);
+    });
+
+    // upward pass: subtrees in parallel, then the serial top levels
+    const std::vector<int>& roots = tree.subtreeRoots;
+    pool.parallelForThreads(0, (int)roots.size(), 1, [&](int first, int last, int thread){
+        for(int r = first; r < last; r++){
+            upward(roots[r], scratch[thread]);
+        }
+    });
+    if (!tree.isSubtreeRoot(0)){
+        upward(0, scratch[0]);
+    }
+
+    // walk and downward pass per target subtree
+    pool.parallelForThreads(0, (int)roots.size(), 1, [&](int first, int last, int thread){
+        for(int r = first; r < last; r++){
+            walk(roots[r], eps2, scratch[thread]);
+            downward(roots[r], scratch[thread]);
+        }
+    });
+
+    const int* order = tree.order.data();
+    pool.parallelFor(0, n, 4096, [&](int begin, int end){
+        for(int s = begin; s < end; s++){
+            int i = order[s];
+            ps.ax[i] = G * accX[s];
+            ps.ay[i] = G * accY[s];
+            ps.az[i] = G * accZ[s];
+        }
+    });
+
+    lastInteractions = 0;
+    lastCellInteractions = 0;
+    for(const WalkScratch& s : scratch){
+        lastInteractions += s.interactions;
+        lastCellInteractions += s.cellInteractions;
+    }
+    lastSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Octree.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+#include <vector>
+
+/*
+ * Fast multipole method for mutual (N-body) gravity, O(N) per step.
+ *
+ * Uses the adaptive octree of Octree.h with Cartesian Taylor expansions
+ * up to expansionOrder, centred on each cell's centre of mass:
+ *
+ *  - upward pass: particle moments of the leaves (P2M) shifted into
+ *    their parents (M2M), subtrees in parallel, then the top levels
+ *  - dual tree walk: two cells whose bounding spheres satisfy
+ *    (rA + rB) < openingAngle * distance interact through their
+ *    expansions (M2L), two leaves that do not are summed directly (P2P)
+ *  - downward pass: local expansions shifted into the children (L2L)
+ *    and evaluated at the particles of the leaves (L2P)
+ *
+ * Each parallel subtree of the octree is a target task: its walk, local
+ * expansions and particles are touched by that task only, so there are
+ * no write conflicts and results do not depend on the thread count.
+ * The expansions are of the Plummer-softened kernel (r^2 + softening^2)^(-1/2),
+ * the same force as the direct sum. Higher orders cost more per cell
+ * pair but let a larger opening angle reach the same accuracy.
+ */
+class FastMultipole{
+  public:
+    int expansionOrder = 4; // 1 - 8
+    float openingAngle = 0.7f;
+    int leafCapacity = 64;  // larger leaves than Barnes-Hut: P2P is SIMD, M2L is not
+
+    // P2P pair interactions, M2L cell interactions and wall time of the last call
+    long long lastInteractions = 0;
+    long long lastCellInteractions = 0;
+    double lastSeconds = 0.0;
+
+    // tree of the last force pass
+    Octree tree;
+
+    // Overwrite ps.ax/ay/az of the listed particles with their mutual gravity
+    void computeAccelerations(ParticleSystem& ps, const std::vector<int>& indices, float G, float softening, ThreadPool& pool);
+
+  private:
+    // Multi-index bookkeeping for one expansion order. Terms x^a y^b z^c
+    // with a+b+c <= order are numbered by increasing degree.
+    struct Term{ int a, b, c, degree; };
+    struct ShiftEntry{ int source, power; double coefficient; };
+
+    struct Expansion{
+      int order = -1;
+      std::vector<Term> terms;
+      std::vector<int> index;          // (a, b, c) -> term, (order+1)^3 table
+      std::vector<int> parent, axis;   // term = parent term * coordinate[axis]
+
+      // derivative recurrence: term - e_i and term - 2 e_i, -1 if absent
+      std::vector<int> minusOne, minusTwo;
+
+      // per target term, a range of ShiftEntry in the flattened tables
+      std::vector<int> m2mStart, m2lStart, l2lStart;
+      std::vector<ShiftEntry> m2m, m2l, l2l;
+
+      int size() const { return (int)terms.size(); }
+      int find(int a, int b, int c) const { return index[(a * (order + 1) + b) * (order + 1) + c]; }
+      void prepare(int order);
+    };
+
+    // per-thread walk scratch, reused between steps
+    struct WalkScratch{
+      std::vector<int> stack;
+      std::vector<double> derivatives, powers;
+      long long interactions = 0, cellInteractions = 0;
+    };
+
+    Expansion expansion;
+    std::vector<double> multipoles, locals; // nodes * expansion.size()
+    std::vector<float> accX, accY, accZ;    // per sorted slot, without G
+    std::vector<WalkScratch> scratch;
+
+    void powersOf(double x, double y, double z, double* out) const;
+    void upward(int node, WalkScratch& s);
+    void walk(int target, float eps2, WalkScratch& s);
+    void multipoleToLocal(int target, int source, double eps2, WalkScratch& s);
+    void particleToParticle(int target, int source, float eps2, WalkScratch& s);
+    void downward(int node, WalkScratch& s);
+};
@@ -0,0 +1,279 @@
+#include "HardSpheres.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static const double never = std::numeric_limits<double>::infinity();
+
+void HardSpheres::build(const ParticleSystem& ps, const std::vector<int>& indices, const SimParams& params){
+    int n = (int)indices.size();
+    builtRadius = params.boundaryRadius;
+    builtBoundary = params.sphereBoundary;
+
+    ids.resize(n);
+    position.resize(n);
+    velocity.resize(n);
+    positionTime.assign(n, now);
+    radius.resize(n);
+    mass.resize(n);
+    eventCount.assign(n, 0);
+    wallTime.assign(n, never);
+    crossTime.assign(n, never);
+    cell.resize(n);
+
+    double maxRadius = 0.0;
+    for(int k = 0; k < n; k++){
+        int i = indices[k];
+        ids[k] = ps.id[i];
+        position[k] = glm::dvec3(ps.position(i));
+        velocity[k] = glm::dvec3(ps.velocity(i));
+        radius[k] = ps.radius[i];
+        mass[k] = ps.mass[i];
+        maxRadius = std::max(maxRadius, radius[k]);
+    }
+
+    // cells at least a diameter wide over the cube around the boundary
+    // sphere, and no more of them than particlesPerCell asks for
+    double extent = 2.0 * params.boundaryRadius;
+    dim = std::max((int)(extent / std::max(2.0 * maxRadius, 1e-3)), 1);
+    dim = std::min(dim, std::max((int)std::cbrt(n / particlesPerCell), 1));
+    while((long long)dim * dim * dim > maxCells){
+        dim--;
+    }
+    cellSize = extent / dim;
+    origin = -params.boundaryRadius;
+
+    cellHead.assign((size_t)dim * dim * dim, -1);
+    nextInCell.assign(n, -1);
+    prevInCell.assign(n, -1);
+    for(int k = 0; k < n; k++){
+        glm::dvec3 local = (position[k] - origin) / cellSize;
+        cell[k] = glm::clamp(glm::ivec3(glm::floor(local)), glm::ivec3(0), glm::ivec3(dim - 1));
+        insertInCell(k);
+    }
+
+    calendar = std::priority_queue<Event, std::vector<Event>, Later>();
+    for(int k = 0; k < n; k++){
+        predictWall(k);
+        predictCrossing(k);
+    }
+    // every pair is predicted twice here; the second copy goes stale with the first
+    for(int k = 0; k < n; k++){
+        predictPairs(k);
+    }
+
+    totalCollisions = 0;
+    valid = true;
+}
+
+void HardSpheres::insertInCell(int i){
+    int c = cellIndex(cell[i]);
+    prevInCell[i] = -1;
+    nextInCell[i] = cellHead[c];
+    if (cellHead[c] >= 0){
+        prevInCell[cellHead[c]] = i;
+    }
+    cellHead[c] = i;
+}
+
+void HardSpheres::removeFromCell(int i){
+    if (prevInCell[i] >= 0){
+        nextInCell[prevInCell[i]] = nextInCell[i];
+    }
+    else{
+        cellHead[cellIndex(cell[i])] = nextInCell[i];
+    }
+    if (nextInCell[i] >= 0){
+        prevInCell[nextInCell[i]] = prevInCell[i];
+    }
+}
+
+void HardSpheres::predictWall(int i){
+    wallTime[i] = never;
+    if (!builtBoundary){
+        return;
+    }
+
+    // leaving the sphere of radius R - r about the origin: |p + v t| = R - r
+    glm::dvec3 p = positionAt(i, now);
+    glm::dvec3 v = velocity[i];
+    double reach = builtRadius - radius[i];
+    double a = glm::dot(v, v);
+    double b = glm::dot(p, v);
+    double c = glm::dot(p, p) - reach * reach;
+    if (a <= 0.0){
+        return;
+    }
+
+    double t;
+    if (c >= 0.0 && b >= 0.0){
+        t = 0.0;                               // on or outside and moving out
+    }
+    else{
+        double discriminant = b * b - a * c;
+        if (discriminant < 0.0){
+            return;                            // outside, passing the sphere by
+        }
+        // the larger root, in the form that does not cancel
+        double root = std::sqrt(discriminant);
+        t = b > 0.0 ? -c / (b + root) : (root - b) / a;
+        t = std::max(t, 0.0);
+    }
+
+    wallTime[i] = now + t;
+    calendar.push(Event{ wallTime[i], WallHit, i, -1, eventCount[i], 0 });
+}
+
+void HardSpheres::predictCrossing(int i){
+    crossTime[i] = never;
+    glm::dvec3 p = positionAt(i, now);
+
+    double best = never;
+    int bestAxis = -1;
+    for(int axis = 0; axis < 3; axis++){
+        double v = velocity[i][axis];
+        int c = cell[i][axis];
+        double t = never;
+        if (v > 0.0 && c + 1 < dim){
+            t = (origin + (c + 1) * cellSize - p[axis]) / v;
+        }
+        else if (v < 0.0 && c > 0){
+            t = (origin + c * cellSize - p[axis]) / v;
+        }
+        if (t < best){
+            best = t;
+            bestAxis = axis * 2 + (v > 0.0 ? 1 : 0);
+        }
+    }
+
+    if (bestAxis >= 0){
+        crossTime[i] = now + std::max(best, 0.0);
+        calendar.push(Event{ crossTime[i], CellCrossing, i, bestAxis, eventCount[i], 0 });
+    }
+}
+
+void HardSpheres::predictPairs(int i){
+    glm::dvec3 pi = positionAt(i, now);
+    glm::ivec3 lo = glm::max(cell[i] - 1, glm::ivec3(0));
+    glm::ivec3 hi = glm::min(cell[i] + 1, glm::ivec3(dim - 1));
+
+    for(int z = lo.z; z <= hi.z; z++){
+        for(int y = lo.y; y <= hi.y; y++){
+            for(int x = lo.x; x <= hi.x; x++){
+                for(int j = cellHead[cellIndex(glm::ivec3(x, y, z))]; j >= 0; j = nextInCell[j]){
+                    if (j == i){
+                        continue;
+                    }
+
+                    // first root of |d + w t| = r_i + r_j while closing
+                    glm::dvec3 d = positionAt(j, now) - pi;
+                    glm::dvec3 w = velocity[j] - velocity[i];
+                    double b = glm::dot(d, w);
+                    if (b >= 0.0){
+                        continue;
+                    }
+                    double contact = radius[i] + radius[j];
+                    double a = glm::dot(w, w);
+                    double c = glm::dot(d, d) - contact * contact;
+                    double discriminant = b * b - a * c;
+                    if (discriminant < 0.0){
+                        continue;
+                    }
+                    double t = now + std::max(c / (std::sqrt(discriminant) - b), 0.0);
+
+                    // past either particle's next change it is predicted again then
+                    if (t > nextChange(i) || t > nextChange(j)){
+                        continue;
+                    }
+                    calendar.push(Event{ t, PairCollision, std::min(i, j), std::max(i, j),
+                                         eventCount[std::min(i, j)], eventCount[std::max(i, j)] });
+                }
+            }
+        }
+    }
+}
+
+void HardSpheres::advance(ParticleSystem& ps, const std::vector<int>& indices, const SimParams& params, float duration){
+    lastCollisions = 0;
+    lastWallHits = 0;
+    lastCrossings = 0;
+    lastStale = 0;
+
+    if (!valid || indices.size() != ids.size() || params.boundaryRadius != builtRadius || params.sphereBoundary != builtBoundary){
+        build(ps, indices, params);
+    }
+
+    double end = now + duration;
+    while(!calendar.empty() && calendar.top().t <= end){
+        Event event = calendar.top();
+        calendar.pop();
+
+        int a = event.a, b = event.b;
+        if (event.countA != eventCount[a] || (event.type == PairCollision && event.countB != eventCount[b])){
+            lastStale++;
+            continue;
+        }
+        now = event.t;
+
+        if (event.type == PairCollision){
+            moveTo(a, now);
+            moveTo(b, now);
+
+            // exchange the normal components of momentum
+            glm::dvec3 normal = glm::normalize(position[b] - position[a]);
+            double closing = glm::dot(velocity[b] - velocity[a], normal);
+            double totalMass = mass[a] + mass[b];
+            velocity[a] += (2.0 * mass[b] / totalMass * closing) * normal;
+            velocity[b] -= (2.0 * mass[a] / totalMass * closing) * normal;
+
+            eventCount[a]++;
+            eventCount[b]++;
+            predictWall(a);
+            predictCrossing(a);
+            predictWall(b);
+            predictCrossing(b);
+            predictPairs(a);
+            predictPairs(b);
+            lastCollisions++;
+        }
+        else if (event.type == WallHit){
+            moveTo(a, now);
+
+            glm::dvec3 normal = glm::normalize(position[a]);
+            double outward = glm::dot(velocity[a], normal);
+            if (outward > 0.0){
+                velocity[a] -= 2.0 * outward * normal;
+            }
+
+            eventCount[a]++;
+            predictWall(a);
+            predictCrossing(a);
+            predictPairs(a);
+            lastWallHits++;
+        }
+        else{
+            // the crossing is taken from the event, not the position, so
+            // round-off at the face cannot bounce it back
+            removeFromCell(a);
+            cell[a][b / 2] += (b & 1) ? 1 : -1;
+            insertInCell(a);
+
+            predictCrossing(a);
+            predictPairs(a);
+            lastCrossings++;
+        }
+    }
+    now = end;
+
+    for(int k = 0; k < (int)ids.size(); k++){
+        moveTo(k, now);
+        int i = ps.indexOf(ids[k]);
+        ps.setPosition(i, glm::vec3(position[k]));
+        ps.setVelocity(i, glm::vec3(velocity[k]));
+        ps.setAcceleration(i, glm::vec3(0.0f));
+    }
+
+    totalCollisions += lastCollisions;
+    lastCalendarSize = (int)calendar.size();
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "ParticleSystem.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+/*
+ * Event-driven hard-sphere dynamics.
+ *
+ * Instead of stepping every particle and correcting overlaps afterwards,
+ * the particles fly in straight lines and the system jumps from one event
+ * to the next: two spheres touching, a sphere reaching the boundary, or a
+ * sphere crossing into another cell of a uniform grid. Collisions are
+ * exact and elastic (equal and opposite impulses along the line of
+ * centres, weighted by mass), the boundary reflects specularly, and
+ * params.damping and gravity are not applied. Kinetic energy is conserved
+ * to round-off however large the step, and a dilute gas costs per
+ * collision rather than per particle per step.
+ *
+ * Events wait in a priority queue (the calendar) ordered by time. A
+ * particle's state is only brought up to date when one of its events
+ * fires; every change of velocity bumps its event count, and an event
+ * whose particles' counts have moved on since it was predicted is stale
+ * and dropped when it reaches the front of the queue. The grid cells are
+ * at least one diameter wide, so a pair can only touch while in adjacent
+ * cells: a pair collision is only predicted if it comes before either
+ * particle's next crossing or wall hit, and a particle predicts again
+ * against its 27 neighbouring cells whenever it crosses into a new cell
+ * or changes velocity. Cells outside the grid are clamped onto its edge,
+ * so open domains (params.sphereBoundary off) still work, at the cost of
+ * crowded edge cells for particles far outside.
+ *
+ * Positions and velocities are held in double precision between calls
+ * and written back to the ParticleSystem at the end of each advance().
+ * The calendar is rebuilt from the ParticleSystem when the set of
+ * particles or the boundary changes, or after invalidate().
+ */
+class HardSpheres{
+  public:
+    // Particles per cell of the grid over the boundary sphere's cube, when
+    // that gives cells wider than a diameter. Small cells mean few pairs
+    // to predict against, large ones few crossings; in a dilute gas the
+    // crossings dominate.
+    float particlesPerCell = 0.25f;
+
+    // cap on the cells of the grid
+    int maxCells = 1 << 21;
+
+    // statistics of the last advance()
+    long long lastCollisions = 0;
+    long long lastWallHits = 0;
+    long long lastCrossings = 0;
+    long long lastStale = 0;       // events dropped because they were out of date
+    int lastCalendarSize = 0;      // events waiting at the end
+
+    // and since the last rebuild
+    long long totalCollisions = 0;
+
+    // Rebuild the calendar from the ParticleSystem on the next advance(),
+    // e.g. after the particles were moved by something else
+    void invalidate(){ valid = false; }
+
+    // Move the particles listed in indices on by duration, event by event
+    void advance(ParticleSystem& ps, const std::vector<int>& indices, const SimParams& params, float duration);
+
+  private:
+    enum EventType { PairCollision, WallHit, CellCrossing };
+
+    struct Event{
+      double t;
+      int type;
+      int a, b;              // for a crossing, b is axis * 2 + 1 if it goes up the axis
+      uint32_t countA, countB;
+    };
+
+    // earliest at the front of the queue, ties broken by type and particles
+    struct Later{
+      bool operator()(const Event& x, const Event& y) const {
+        if (x.t != y.t) return x.t > y.t;
+        if (x.type != y.type) return x.type > y.type;
+        if (x.a != y.a) return x.a > y.a;
+        return x.b > y.b;
+      }
+    };
+
+    bool valid = false;
+    double now = 0.0;
+    float builtRadius = 0.0f;
+    bool builtBoundary = true;
+
+    // per particle, in the order the indices had at the build; id finds
+    // the particle again after a reorder
+    std::vector<int> ids;
+    std::vector<glm::dvec3> position, velocity;   // position at positionTime
+    std::vector<double> positionTime;
+    std::vector<double> radius, mass;
+    std::vector<uint32_t> eventCount;
+    std::vector<double> wallTime, crossTime;      // next wall hit and cell crossing
+
+    // cells of the grid, each a doubly linked list of particles
+    int dim = 0;
+    double cellSize = 1.0;
+    double origin = 0.0;
+    std::vector<glm::ivec3> cell;
+    std::vector<int> cellHead, nextInCell, prevInCell;
+
+    std::priority_queue<Event, std::vector<Event>, Later> calendar;
+
+    void build(const ParticleSystem& ps, const std::vector<int>& indices, const SimParams& params);
+
+    glm::dvec3 positionAt(int i, double t) const { return position[i] + velocity[i] * (t - positionTime[i]); }
+    void moveTo(int i, double t){
+      position[i] = positionAt(i, t);
+      positionTime[i] = t;
+    }
+
+    int cellIndex(glm::ivec3 c) const { return (c.z * dim + c.y) * dim + c.x; }
+    void insertInCell(int i);
+    void removeFromCell(int i);
+
+    double nextChange(int i) const { return wallTime[i] < crossTime[i] ? wallTime[i] : crossTime[i]; }
+
+    void predictWall(int i);
+    void predictCrossing(int i);
+    void predictPairs(int i);
+};
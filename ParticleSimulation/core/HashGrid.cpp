@@ -0,0 +1,185 @@
+#include "HashGrid.h"
+#include "SpatialGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+// particles (or table slots, or cells) per parallel-for chunk
+static const int grain = 4096;
+
+// cell coordinates are packed into 20 bits per axis, biased so the
+// origin sits in the middle; a particle beyond that range is clamped
+// onto the outermost cells, which keeps every overlapping pair adjacent
+static const int coordBits = 20;
+static const int coordBias = 1 << (coordBits - 1);
+static const int coordMax = (1 << coordBits) - 1;
+static const uint64_t coordMask = (uint64_t)coordMax;
+static const uint64_t emptyKey = ~(uint64_t)0;
+
+static uint64_t packCell(int x, int y, int z){
+    return (uint64_t)x | ((uint64_t)y << coordBits) | ((uint64_t)z << (2 * coordBits));
+}
+
+static void unpackCell(uint64_t key, int& x, int& y, int& z){
+    x = (int)(key & coordMask);
+    y = (int)((key >> coordBits) & coordMask);
+    z = (int)((key >> (2 * coordBits)) & coordMask);
+}
+
+uint64_t HashGrid::cellKey(float x, float y, float z) const {
+    auto coord = [&](float v){
+        float c = std::floor(v / cellSize) + (float)coordBias;
+        return (int)std::min(std::max(c, 0.0f), (float)coordMax);
+    };
+    return packCell(coord(x), coord(y), coord(z));
+}
+
+// Fibonacci hashing: the high bits of the product are well mixed
+static int slotOf(uint64_t key, int tableBits){
+    return (int)((key * 0x9E3779B97F4A7C15ull) >> (64 - tableBits));
+}
+
+int HashGrid::insert(uint64_t key){
+    int mask = capacity - 1;
+    for(int slot = slotOf(key, tableBits); ; slot = (slot + 1) & mask){
+        uint64_t current = tableKeys[slot].load(std::memory_order_acquire);
+        if (current == emptyKey){
+            // claim the slot; losing the race to the same key is fine too
+            if (tableKeys[slot].compare_exchange_strong(current, key, std::memory_order_acq_rel) || current == key){
+                return slot;
+            }
+        }
+        else if (current == key){
+            return slot;
+        }
+    }
+}
+
+int HashGrid::find(uint64_t key) const {
+    int mask = capacity - 1;
+    for(int slot = slotOf(key, tableBits); ; slot = (slot + 1) & mask){
+        uint64_t current = tableKeys[slot].load(std::memory_order_relaxed);
+        if (current == key){
+            return slot;
+        }
+        if (current == emptyKey){
+            return -1;
+        }
+    }
+}
+
+long long HashGrid::memoryBytes() const {
+    return (long long)capacity * (sizeof(uint64_t) + sizeof(int) + sizeof(int))
+         + (long long)(cellKeys.capacity() + blockKeys.capacity()) * sizeof(uint64_t)
+         + (long long)(cellStart.capacity() + forwardCells.capacity() + blockCells.capacity()) * sizeof(int)
+         + (long long)(cellParticles.capacity() + particleSlot.capacity() + cursor.capacity()) * sizeof(int);
+}
+
+void HashGrid::build(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool){
+    int count = (int)indices.size();
+
+    float maxRadius = 0.0f;
+    for(int i : indices){
+        maxRadius = std::max(maxRadius, ps.radius[i]);
+    }
+    cellSize = std::max(2.0f * maxRadius, 1e-3f);
+
+    // at most half full, so probe sequences stay short
+    int wanted = 16;
+    while(wanted < 2 * count){
+        wanted *= 2;
+    }
+    if (wanted != capacity){
+        capacity = wanted;
+        for(tableBits = 0; (1 << tableBits) < capacity; tableBits++){}
+        tableKeys.reset(new std::atomic<uint64_t>[capacity]);
+        tableCounts.reset(new std::atomic<int>[capacity]);
+    }
+    pool.parallelFor(0, capacity, grain, [&](int begin, int end){
+        for(int s = begin; s < end; s++){
+            tableKeys[s].store(emptyKey, std::memory_order_relaxed);
+            tableCounts[s].store(0, std::memory_order_relaxed);
+        }
+    });
+
+    // lock-free parallel insertion
+    particleSlot.resize(count);
+    pool.parallelFor(0, count, grain, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            int i = indices[k];
+            int slot = insert(cellKey(ps.px[i], ps.py[i], ps.pz[i]));
+            particleSlot[k] = slot;
+            tableCounts[slot].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    // pack the occupied slots into cells
+    slotCell.resize(capacity);
+    cellKeys.clear();
+    cellStart.assign(1, 0);
+    for(int s = 0; s < capacity; s++){
+        uint64_t key = tableKeys[s].load(std::memory_order_relaxed);
+        if (key != emptyKey){
+            slotCell[s] = (int)cellKeys.size();
+            cellKeys.push_back(key);
+            cellStart.push_back(cellStart.back() + tableCounts[s].load(std::memory_order_relaxed));
+        }
+    }
+    int numCells = (int)cellKeys.size();
+
+    // scatter in list order, so each cell's particles are in a fixed order
+    cellParticles.resize(count);
+    cursor.assign(cellStart.begin(), cellStart.end() - 1);
+    for(int k = 0; k < count; k++){
+        int c = slotCell[particleSlot[k]];
+        cellParticles[cursor[c]++] = indices[k];
+    }
+
+    // forward neighbours and the colour block key of every occupied cell
+    forwardCells.resize(13 * numCells);
+    blockKeys.resize(numCells);
+    blockCells.resize(numCells);
+    pool.parallelFor(0, numCells, grain, [&](int begin, int end){
+        for(int c = begin; c < end; c++){
+            int x, y, z;
+            unpackCell(cellKeys[c], x, y, z);
+
+            for(int o = 0; o < 13; o++){
+                int nx = x + SpatialGrid::forward[o][0], ny = y + SpatialGrid::forward[o][1], nz = z + SpatialGrid::forward[o][2];
+                int slot = -1;
+                if (nx >= 0 && ny >= 0 && nz >= 0 && nx <= coordMax && ny <= coordMax && nz <= coordMax){
+                    slot = find(packCell(nx, ny, nz));
+                }
+                forwardCells[13 * c + o] = slot < 0 ? -1 : slotCell[slot];
+            }
+
+            uint64_t bx = x >> 1, by = y >> 1, bz = z >> 1;
+            uint64_t colour = (bx & 1) | ((by & 1) << 1) | ((bz & 1) << 2);
+            uint64_t local = (x & 1) | ((y & 1) << 1) | ((z & 1) << 2);
+            blockKeys[c] = (colour << 60) | (bz << 41) | (by << 22) | (bx << 3) | local;
+            blockCells[c] = c;
+        }
+    });
+
+    // sort by colour, block, then cell within the block
+    sorter.sort(blockKeys, blockCells, 63, pool);
+
+    int colourCounts[numColours] = {};
+    batchStart.assign(1, 0);
+    for(int b = 0; b < numCells; b++){
+        if (b == 0 || (blockKeys[b] >> 3) != (blockKeys[b - 1] >> 3)){
+            if (b > 0){
+                batchStart.push_back(b);
+            }
+            colourCounts[blockKeys[b] >> 60]++;
+        }
+    }
+    if (numCells > 0){
+        batchStart.push_back(numCells);
+    }
+
+    colourBatchStart[0] = 0;
+    for(int colour = 0; colour < numColours; colour++){
+        colourBatchStart[colour + 1] = colourBatchStart[colour] + colourCounts[colour];
+    }
+}
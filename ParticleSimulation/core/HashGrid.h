@@ -0,0 +1,102 @@
+#pragma once
+
+#include "ParticleSystem.h"
+#include "RadixSort.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * Sparse uniform grid in an open-addressing hash table.
+ *
+ * Cells are keyed by their integer coordinates, so there are no bounds:
+ * memory follows the number of occupied cells (the table has at least
+ * twice as many slots as particles) and a particle far from the origin
+ * costs the same as one near it. SpatialGrid instead allocates the whole
+ * bounding box and coarsens its cells once that gets too large.
+ *
+ * Particles are inserted in parallel without locks: each claims its
+ * cell's slot with a compare-and-swap on the key (linear probing) and
+ * bumps the slot's count atomically. The occupied slots are then packed
+ * into a CSR cell list, and each cell's 13 forward neighbours are looked
+ * up once so the pair loops never probe the table.
+ *
+ * Occupied cells are grouped into the same 2x2x2 colour blocks as in
+ * SpatialGrid, sorted by key, so every block of a colour can be resolved
+ * in parallel and the pair order does not depend on the thread count or
+ * on where the keys landed in the table.
+ */
+class HashGrid{
+  public:
+    static const int numColours = 8;
+
+    // statistics of the last build
+    int occupiedCells() const { return (int)cellKeys.size(); }
+    int tableSize() const { return capacity; }
+    long long memoryBytes() const;
+
+    // Bin the listed particles into cells of the largest diameter
+    void build(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool);
+
+    // Batches are the occupied colour blocks
+    int colourBatchCount(int colour) const { return colourBatchStart[colour + 1] - colourBatchStart[colour]; }
+
+    // Visit the pairs of the k-th block of a colour, cell by cell with
+    // each cell's forward neighbours as in SpatialGrid::forEachPairInCell
+    template <typename PairFn>
+    void forEachPairInColourBatch(int colour, int k, PairFn visit) const {
+      int batch = colourBatchStart[colour] + k;
+      for(int b = batchStart[batch]; b < batchStart[batch + 1]; b++){
+        int c = blockCells[b];
+        int begin = cellStart[c], end = cellStart[c + 1];
+
+        for(int a = begin; a < end; a++){
+          for(int q = a + 1; q < end; q++){
+            visit(cellParticles[a], cellParticles[q]);
+          }
+        }
+
+        for(int o = 0; o < 13; o++){
+          int n = forwardCells[13 * c + o];
+          if (n < 0) continue;
+          for(int a = begin; a < end; a++){
+            for(int q = cellStart[n]; q < cellStart[n + 1]; q++){
+              visit(cellParticles[a], cellParticles[q]);
+            }
+          }
+        }
+      }
+    }
+
+  private:
+    float cellSize = 1.0f;
+
+    // open-addressing table: packed cell coordinates (or emptyKey) and particle counts
+    int capacity = 0, tableBits = 0;
+    std::unique_ptr<std::atomic<uint64_t>[]> tableKeys;
+    std::unique_ptr<std::atomic<int>[]> tableCounts;
+    std::vector<int> slotCell;   // table slot -> occupied cell
+
+    // occupied cells: packed coordinates, CSR particle lists, forward neighbours (-1 if empty)
+    std::vector<uint64_t> cellKeys;
+    std::vector<int> cellStart;
+    std::vector<int> cellParticles;
+    std::vector<int> forwardCells;
+
+    // table slot of each listed particle
+    std::vector<int> particleSlot;
+    std::vector<int> cursor;
+
+    // cells sorted by colour, block and position in the block
+    std::vector<uint64_t> blockKeys;
+    std::vector<int> blockCells;
+    std::vector<int> batchStart;
+    int colourBatchStart[numColours + 1] = {};
+    RadixSorter sorter;
+
+    uint64_t cellKey(float x, float y, float z) const;
+    int insert(uint64_t key);
+    int find(uint64_t key) const;
+};
@@ -0,0 +1,154 @@
+#include "HierarchicalGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+// finer particles per parallel-for chunk in the cross-level search
+static const int crossGrain = 1024;
+
+// cell budget of a level's grid per particle in that level
+static const int cellsPerParticle = 8;
+
+void HierarchicalGrid::build(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool){
+    levelCount = 0;
+    lastCrossPairs = 0;
+    if (indices.empty()){
+        return;
+    }
+
+    float minRadius = ps.radius[indices[0]];
+    for(int i : indices){
+        minRadius = std::min(minRadius, ps.radius[i]);
+    }
+    minRadius = std::max(minRadius, 1e-6f);
+
+    if ((int)levels.size() < maxLevels){
+        levels.resize(maxLevels);
+    }
+    for(Level& level : levels){
+        level.particles.clear();
+        level.maxRadius = 0.0f;
+    }
+
+    // level = ceil(log2(r / smallest r)), so each level spans a factor 2 in size
+    for(int i : indices){
+        int l = (int)std::ceil(std::log2(ps.radius[i] / minRadius) - 1e-6f);
+        l = std::max(0, std::min(l, maxLevels - 1));
+        levels[l].particles.push_back(i);
+        levels[l].maxRadius = std::max(levels[l].maxRadius, ps.radius[i]);
+        levelCount = std::max(levelCount, l + 1);
+    }
+
+    // a sparse level gets coarser cells rather than mostly empty ones, so
+    // the cells of all levels together stay proportional to the particles
+    for(int l = 0; l < levelCount; l++){
+        Level& level = levels[l];
+        level.grid.maxCells = std::max(64, std::min(1 << 22, cellsPerParticle * (int)level.particles.size()));
+        level.grid.build(level.particles, [&](int i){ return ps.position(i); }, level.maxRadius);
+    }
+
+    // cross-level pairs, grouped under the level of the larger particle
+    finer.clear();
+    for(int l = 0; l < levelCount; l++){
+        Level& level = levels[l];
+        level.crossFirst.clear();
+        level.crossSecond.clear();
+        level.crossBatchStart.assign(1, 0);
+        std::fill(level.colourBatchStart, level.colourBatchStart + SpatialGrid::numColours + 1, 0);
+
+        if (!level.particles.empty() && !finer.empty()){
+            const SpatialGrid& grid = level.grid;
+
+            int numChunks = ((int)finer.size() + crossGrain - 1) / crossGrain;
+            if ((int)chunkPairs.size() < numChunks){
+                chunkPairs.resize(numChunks);
+            }
+
+            // each smaller particle checks the coarse cells its box reaches
+            pool.parallelFor(0, numChunks, 1, [&](int first, int last){
+                for(int chunk = first; chunk < last; chunk++){
+                    std::vector<int>& out = chunkPairs[chunk];
+                    out.clear();
+
+                    int end = std::min((int)finer.size(), (chunk + 1) * crossGrain);
+                    for(int f = chunk * crossGrain; f < end; f++){
+                        int i = finer[f];
+                        glm::vec3 p = ps.position(i);
+                        glm::vec3 reach(ps.radius[i] + level.maxRadius);
+                        glm::ivec3 lo = grid.cellCoord(p - reach);
+                        glm::ivec3 hi = grid.cellCoord(p + reach);
+
+                        for(int z = lo.z; z <= hi.z; z++){
+                            for(int y = lo.y; y <= hi.y; y++){
+                                for(int x = lo.x; x <= hi.x; x++){
+                                    int c = grid.cellIndex(x, y, z);
+                                    for(int a = grid.cellStart[c]; a < grid.cellStart[c + 1]; a++){
+                                        int j = grid.cellParticles[a];
+                                        float reach = ps.radius[i] + ps.radius[j];
+                                        float dx = ps.px[i] - ps.px[j], dy = ps.py[i] - ps.py[j], dz = ps.pz[i] - ps.pz[j];
+                                        if (std::abs(dx) <= reach && std::abs(dy) <= reach && std::abs(dz) <= reach){
+                                            out.push_back(i);
+                                            out.push_back(j);
+                                            out.push_back(c);
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            });
+
+            // key each pair by the colour block of the larger particle's cell
+            keys.clear();
+            order.clear();
+            std::vector<int>& first = level.crossSecond; // scratch until the sort is done
+            first.clear();
+            for(int chunk = 0; chunk < numChunks; chunk++){
+                const std::vector<int>& pairs = chunkPairs[chunk];
+                for(size_t p = 0; p < pairs.size(); p += 3){
+                    int c = pairs[p + 2];
+                    int x = c % grid.dimX, y = (c / grid.dimX) % grid.dimY, z = c / (grid.dimX * grid.dimY);
+                    int k;
+                    int colour = grid.colourBlockOf(x, y, z, k);
+                    keys.push_back(((uint64_t)colour << 32) | (uint64_t)k);
+                    order.push_back((int)first.size() / 2);
+                    first.push_back(pairs[p]);
+                    first.push_back(pairs[p + 1]);
+                }
+            }
+            sorter.sort(keys, order, 35, pool);
+
+            int count = (int)keys.size();
+            level.crossFirst.resize(count);
+            secondScratch.resize(count);
+            for(int s = 0; s < count; s++){
+                level.crossFirst[s] = first[2 * order[s]];
+                secondScratch[s] = first[2 * order[s] + 1];
+            }
+            // the pair buffer becomes the scratch for the next level
+            level.crossSecond.swap(secondScratch);
+
+            // batch boundaries and the first batch of each colour
+            int colourCounts[SpatialGrid::numColours] = {};
+            for(int s = 0; s < count; s++){
+                if (s > 0 && keys[s] != keys[s - 1]){
+                    level.crossBatchStart.push_back(s);
+                }
+                if (s == 0 || keys[s] != keys[s - 1]){
+                    colourCounts[keys[s] >> 32]++;
+                }
+            }
+            if (count > 0){
+                level.crossBatchStart.push_back(count);
+            }
+            for(int colour = 0; colour < SpatialGrid::numColours; colour++){
+                level.colourBatchStart[colour + 1] = level.colourBatchStart[colour] + colourCounts[colour];
+            }
+
+            lastCrossPairs += count;
+        }
+
+        finer.insert(finer.end(), level.particles.begin(), level.particles.end());
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "ParticleSystem.h"
+#include "RadixSort.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+#include <vector>
+
+/*
+ * Multi-level uniform grid for particles whose radii differ widely.
+ *
+ * Level L holds the particles with diameter in (d * 2^(L-1), d * 2^L],
+ * d being the smallest diameter, in a SpatialGrid sized for that level's
+ * largest particle. Small particles therefore never share cells sized
+ * for boulders, and boulders never span many small cells.
+ *
+ * Pairs within a level come from that level's grid and its colour
+ * blocks. Pairs across levels are found from the smaller particle, which
+ * only looks at the few coarse cells its box touches, and are then
+ * grouped by the colour block of the larger particle's cell. A smaller
+ * particle cannot overlap two larger ones in same-coloured blocks, so
+ * every batch of a colour can be resolved in parallel without locks,
+ * as in the single grid.
+ */
+class HierarchicalGrid{
+  public:
+    int maxLevels = 12;
+
+    struct Level{
+      SpatialGrid grid;
+      std::vector<int> particles;
+      float maxRadius = 0.0f;
+
+      // cross-level pairs with their larger particle in this level,
+      // batched by that particle's colour block
+      std::vector<int> crossFirst, crossSecond;
+      std::vector<int> crossBatchStart;
+      int colourBatchStart[SpatialGrid::numColours + 1] = {};
+    };
+
+    std::vector<Level> levels;
+    int levelCount = 0;
+
+    // statistics of the last build
+    int lastCrossPairs = 0;
+
+    // Bin the listed particles and collect the cross-level pairs whose
+    // bounding boxes overlap at the current positions
+    void build(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool);
+
+    int crossBatchCount(int level, int colour) const {
+      const Level& l = levels[level];
+      return l.colourBatchStart[colour + 1] - l.colourBatchStart[colour];
+    }
+
+    // Visit the cross-level pairs (smaller, larger) of the k-th batch of a colour
+    template <typename PairFn>
+    void forEachCrossPairInBatch(int level, int colour, int k, PairFn visit) const {
+      const Level& l = levels[level];
+      int batch = l.colourBatchStart[colour] + k;
+      for(int p = l.crossBatchStart[batch]; p < l.crossBatchStart[batch + 1]; p++){
+        visit(l.crossFirst[p], l.crossSecond[p]);
+      }
+    }
+
+  private:
+    std::vector<int> finer;   // particles of the levels below the current one
+    std::vector<std::vector<int>> chunkPairs;
+    std::vector<uint64_t> keys;
+    std::vector<int> order;
+    std::vector<int> secondScratch; // sorted second indices, swapped into crossSecond
+    RadixSorter sorter;
+};
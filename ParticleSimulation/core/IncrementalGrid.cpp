@@ -0,0 +1,186 @@
+#include "IncrementalGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// particles per parallel-for chunk when recomputing cells
+static const int particleGrain = 4096;
+
+// bounds padding at a compaction, in cells and as a fraction of the extent,
+// so drifting particles stay inside until the next one
+static const float padCells = 1.0f;
+static const float padFraction = 0.02f;
+
+void IncrementalGrid::compact(const ParticleSystem& ps, const std::vector<int>& indices){
+    int n = (int)ps.size();
+
+    float maxRadius = 0.0f;
+    for(int i : indices){
+        maxRadius = std::max(maxRadius, ps.radius[i]);
+    }
+    grid.cellSize = std::max(2.0f * maxRadius, 1e-3f);
+
+    // bounds of the tracked particles, ignoring non-finite positions
+    glm::vec3 lo(std::numeric_limits<float>::max());
+    glm::vec3 hi(-std::numeric_limits<float>::max());
+    for(int i : indices){
+        glm::vec3 p = ps.position(i);
+        if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) continue;
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    if (lo.x > hi.x) lo = hi = glm::vec3(0.0f);
+
+    // padding, kept within float range so the bounds stay finite
+    glm::vec3 extent = hi - lo;
+    float pad = padCells * grid.cellSize + padFraction * std::max(extent.x, std::max(extent.y, extent.z));
+    const glm::vec3 limit(std::numeric_limits<float>::max());
+    lo = glm::clamp(lo - glm::vec3(pad), -limit, limit);
+    hi = glm::clamp(hi + glm::vec3(pad), -limit, limit);
+
+    grid.fitCells(lo, hi);
+
+    // counting sort with slack: a cell of m particles gets m + m/2 slots,
+    // empty cells get theirs at the end of the array when first entered
+    int numCells = grid.cellCount();
+    cellCount.assign(numCells, 0);
+    cellRange.resize(numCells);
+    particleCell.assign(n, -1);
+    particleSlot.assign(n, -1);
+    for(int i : indices){
+        glm::ivec3 c = grid.cellCoord(ps.position(i));
+        particleCell[i] = grid.cellIndex(c.x, c.y, c.z);
+        cellCount[particleCell[i]]++;
+    }
+
+    int total = 0;
+    for(int c = 0; c < numCells; c++){
+        cellRange[c].begin = total;
+        cellRange[c].capacity = cellCount[c] + (cellCount[c] + 1) / 2;
+        total += cellRange[c].capacity;
+    }
+
+    slots.assign(total, -1);
+    abandonedSlots = 0;
+    std::fill(cellCount.begin(), cellCount.end(), 0);
+    for(int i : indices){
+        int c = particleCell[i];
+        particleSlot[i] = cellRange[c].begin + cellCount[c]++;
+        slots[particleSlot[i]] = i;
+    }
+
+    tracked = (int)indices.size();
+    stepsSinceCompact = 0;
+    valid = true;
+    compactions++;
+}
+
+void IncrementalGrid::growCell(int c){
+    Range& range = cellRange[c];
+    int begin = (int)slots.size();
+    int capacity = 2 * range.capacity + 2;
+    slots.resize(begin + capacity, -1);
+
+    for(int s = 0; s < cellCount[c]; s++){
+        int i = slots[range.begin + s];
+        slots[range.begin + s] = -1;
+        slots[begin + s] = i;
+        particleSlot[i] = begin + s;
+    }
+
+    abandonedSlots += range.capacity;
+    range.begin = begin;
+    range.capacity = capacity;
+}
+
+void IncrementalGrid::insert(int i, int c){
+    if (cellCount[c] == cellRange[c].capacity){
+        growCell(c);
+    }
+    particleCell[i] = c;
+    particleSlot[i] = cellRange[c].begin + cellCount[c]++;
+    slots[particleSlot[i]] = i;
+}
+
+void IncrementalGrid::remove(int i){
+    int c = particleCell[i];
+    int last = cellRange[c].begin + --cellCount[c];
+
+    // the cell's last particle fills the hole
+    int moved = slots[last];
+    slots[particleSlot[i]] = moved;
+    particleSlot[moved] = particleSlot[i];
+    slots[last] = -1;
+
+    particleCell[i] = -1;
+    particleSlot[i] = -1;
+}
+
+void IncrementalGrid::update(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool){
+    int count = (int)indices.size();
+    lastActive = count;
+    totalActive += count;
+    lastCompacted = false;
+
+    auto compactAll = [&](){
+        compact(ps, indices);
+        lastRebinned = count;
+        totalRebinned += count;
+        lastCompacted = true;
+    };
+
+    // particles vanished or were reordered, or it is time to tidy up
+    bool fragmented = abandonedSlots > (int)slots.size() - abandonedSlots;
+    if (!valid || (int)particleCell.size() != (int)ps.size() || count < tracked || fragmented || ++stepsSinceCompact > compactInterval){
+        compactAll();
+        return;
+    }
+
+    // new cells in parallel; note particles that left the bounds or outgrew the cells
+    newCell.resize(count);
+    threadMaxRadius.assign(pool.size(), 0.0f);
+    threadOutside.assign(pool.size(), 0);
+    pool.parallelForThreads(0, count, particleGrain, [&](int begin, int end, int thread){
+        float largest = threadMaxRadius[thread];
+        bool outside = false;
+        for(int k = begin; k < end; k++){
+            int i = indices[k];
+            glm::ivec3 c = glm::ivec3(glm::floor((ps.position(i) - grid.origin) / grid.cellSize));
+            outside |= c.x < 0 || c.y < 0 || c.z < 0 || c.x >= grid.dimX || c.y >= grid.dimY || c.z >= grid.dimZ;
+            newCell[k] = outside ? 0 : grid.cellIndex(c.x, c.y, c.z);
+            largest = std::max(largest, ps.radius[i]);
+        }
+        threadMaxRadius[thread] = largest;
+        threadOutside[thread] |= outside;
+    });
+
+    float maxRadius = *std::max_element(threadMaxRadius.begin(), threadMaxRadius.end());
+    bool outside = std::find(threadOutside.begin(), threadOutside.end(), 1) != threadOutside.end();
+    if (outside || 2.0f * maxRadius > grid.cellSize){
+        compactAll();
+        return;
+    }
+
+    // serial, in index order: only the particles that changed cell (or are new) move
+    int rebinned = 0;
+    for(int k = 0; k < count; k++){
+        int i = indices[k];
+        int c = newCell[k];
+        int old = particleCell[i];
+        if (old == c){
+            continue;
+        }
+        if (old >= 0){
+            remove(i);
+        }
+        else{
+            tracked++;
+        }
+        insert(i, c);
+        rebinned++;
+    }
+
+    lastRebinned = rebinned;
+    totalRebinned += rebinned;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "ParticleSystem.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+#include <vector>
+
+/*
+ * Uniform grid that is kept between steps instead of rebuilt.
+ *
+ * Each cell owns a range of slots with some free space at the end,
+ * and every particle remembers its cell and slot. An update recomputes
+ * the cells in parallel and then only touches the particles whose cell
+ * changed: each one is swapped out of its old cell and appended to the
+ * new one. A pile resting at the bottom of the well re-bins almost
+ * nothing, where a rebuild writes every particle every step.
+ *
+ * A full cell moves its range to the end of the slot array with twice
+ * the room, leaving a hole behind. The slots are compacted (the grid is
+ * rebuilt with fresh slack and bounds) every compactInterval updates,
+ * when holes take up more than the live slots, when a particle leaves
+ * the bounds or outgrows the cells, and when particles disappear. Moves
+ * are applied serially in index order, so the cell contents do not
+ * depend on the thread count.
+ *
+ * Geometry and the colour blocks for lock-free parallel resolution come
+ * from the SpatialGrid member, whose own cell arrays are left empty.
+ */
+class IncrementalGrid{
+  public:
+    // updates between compactions
+    int compactInterval = 64;
+
+    // statistics
+    int lastRebinned = 0;     // particles written by the last update
+    int lastActive = 0;
+    bool lastCompacted = false;
+    long long compactions = 0;
+    long long totalRebinned = 0, totalActive = 0;
+
+    // fraction of the particles re-binned per update, over all updates
+    double rebinnedFraction() const { return totalActive > 0 ? (double)totalRebinned / totalActive : 0.0; }
+
+    // Compact on the next update(), e.g. after the particles were reordered
+    void invalidate(){ valid = false; }
+
+    // Move the listed particles whose cell changed, or compact
+    void update(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool);
+
+    int colourBlockCount(int colour) const { return grid.colourBlockCount(colour); }
+
+    // Visit the pairs of the k-th block of a colour, as SpatialGrid does
+    template <typename PairFn>
+    void forEachPairInColourBlock(int colour, int k, PairFn visit) const {
+      grid.forEachCellInColourBlock(colour, k, [&](int x, int y, int z){
+        forEachPairInCell(x, y, z, visit);
+      });
+    }
+
+  private:
+    SpatialGrid grid;
+    bool valid = false;
+    int stepsSinceCompact = 0;
+    int tracked = 0;
+
+    // cell c owns slots[cellRange[c].begin .. + capacity), the first
+    // cellCount[c] in use. The counts are kept apart so skipping the
+    // (many) empty cells reads as little memory as SpatialGrid does.
+    struct Range{
+      int begin, capacity;
+    };
+
+    std::vector<int> cellCount;
+    std::vector<Range> cellRange;
+    std::vector<int> slots;
+    int abandonedSlots = 0;   // left behind by cells that moved
+
+    // by particle index, -1 when not binned
+    std::vector<int> particleCell;
+    std::vector<int> particleSlot;
+
+    // cell of each listed particle, and per-thread extremes of the parallel pass
+    std::vector<int> newCell;
+    std::vector<float> threadMaxRadius;
+    std::vector<char> threadOutside;
+
+    void compact(const ParticleSystem& ps, const std::vector<int>& indices);
+    void insert(int i, int c);
+    void growCell(int c);
+    void remove(int i);
+
+    template <typename PairFn>
+    void forEachPairInCell(int x, int y, int z, PairFn visit) const {
+      int c = grid.cellIndex(x, y, z);
+      if(cellCount[c] == 0) return;
+      int begin = cellRange[c].begin, end = begin + cellCount[c];
+
+      for(int a = begin; a < end; a++){
+        for(int b = a + 1; b < end; b++){
+          visit(slots[a], slots[b]);
+        }
+      }
+
+      for(const auto& o : SpatialGrid::forward){
+        int nx = x + o[0], ny = y + o[1], nz = z + o[2];
+        if(nx < 0 || ny < 0 || nz < 0 || nx >= grid.dimX || ny >= grid.dimY || nz >= grid.dimZ) continue;
+
+        int n = grid.cellIndex(nx, ny, nz);
+        if(cellCount[n] == 0) continue;
+        int nBegin = cellRange[n].begin, nEnd = nBegin + cellCount[n];
+        for(int a = begin; a < end; a++){
+          for(int b = nBegin; b < nEnd; b++){
+            visit(slots[a], slots[b]);
+          }
+        }
+      }
+    }
+};
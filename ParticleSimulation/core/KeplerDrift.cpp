@@ -0,0 +1,144 @@
+#include "KeplerDrift.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Laguerre usually settles in three to five iterations
+static const int maxIterations = 60;
+static const double tolerance = 1e-14;
+
+// Stumpff functions c0..c3 of z[l] for every lane
+static void stumpff(const double* z, double* c0, double* c1, double* c2, double* c3){
+
+    // quarter every lane as often as the largest |z| needs for the series
+    double largest = 0.0;
+    for(int l = 0; l < keplerLanes; l++){
+        largest = std::max(largest, std::abs(z[l]));
+    }
+    int quarterings = 0;
+    double scale = 1.0;
+    while(largest * scale > 0.1 && quarterings < 60){
+        scale *= 0.25;
+        quarterings++;
+    }
+
+    for(int l = 0; l < keplerLanes; l++){
+        double x = z[l] * scale;
+        c3[l] = (1.0 / 6.0) * (1.0 - x / 20.0 * (1.0 - x / 42.0 * (1.0 - x / 72.0 * (1.0 - x / 110.0 * (1.0 - x / 156.0)))));
+        c2[l] = 0.5 * (1.0 - x / 12.0 * (1.0 - x / 30.0 * (1.0 - x / 56.0 * (1.0 - x / 90.0 * (1.0 - x / 132.0)))));
+    }
+
+    // c2 and c3 of 4x from those of x, with c0 = 1 - x c2 and c1 = 1 - x c3
+    // taken afresh each time: quadrupling c0 and c1 on their own would
+    // lose a lane quartered far more than it needed to a 1 - tiny
+    for(int q = 0; q < quarterings; q++){
+        for(int l = 0; l < keplerLanes; l++){
+            double x = z[l] * scale;
+            double a0 = 1.0 - x * c2[l];
+            double a1 = 1.0 - x * c3[l];
+            c3[l] = 0.25 * (c2[l] + a0 * c3[l]);
+            c2[l] = 0.5 * a1 * a1;
+        }
+        scale *= 4.0;
+    }
+
+    for(int l = 0; l < keplerLanes; l++){
+        c0[l] = 1.0 - z[l] * c2[l];
+        c1[l] = 1.0 - z[l] * c3[l];
+    }
+}
+
+void keplerDrift(double* x, double* y, double* z, double* vx, double* vy, double* vz, int count, double mu, double dt){
+    for(int base = 0; base < count; base += keplerLanes){
+        int lanes = std::min(keplerLanes, count - base);
+
+        double px[keplerLanes], py[keplerLanes], pz[keplerLanes];
+        double ux[keplerLanes], uy[keplerLanes], uz[keplerLanes];
+        double r0[keplerLanes], eta[keplerLanes], zeta[keplerLanes], beta[keplerLanes], s[keplerLanes];
+        double lo[keplerLanes], hi[keplerLanes];
+        double arg[keplerLanes], c0[keplerLanes], c1[keplerLanes], c2[keplerLanes], c3[keplerLanes];
+
+        // a short block repeats its last body in the spare lanes
+        for(int l = 0; l < keplerLanes; l++){
+            int k = base + std::min(l, lanes - 1);
+            px[l] = x[k]; py[l] = y[k]; pz[l] = z[k];
+            ux[l] = vx[k]; uy[l] = vy[k]; uz[l] = vz[k];
+        }
+
+        for(int l = 0; l < keplerLanes; l++){
+            r0[l] = std::sqrt(px[l] * px[l] + py[l] * py[l] + pz[l] * pz[l]);
+            eta[l] = px[l] * ux[l] + py[l] * uy[l] + pz[l] * uz[l];
+            beta[l] = 2.0 * mu / r0[l] - (ux[l] * ux[l] + uy[l] * uy[l] + uz[l] * uz[l]);
+            zeta[l] = mu - beta[l] * r0[l];
+            s[l] = dt / r0[l];
+            lo[l] = 0.0;
+            hi[l] = std::numeric_limits<double>::infinity();
+        }
+
+        // Laguerre's method (n = 5) on Kepler's equation in s. The left
+        // side grows with s (its derivative is r), so the root stays
+        // bracketed, and a step that leaves the bracket (or overflowed, a
+        // fast hyperbolic pass from a far guess) bisects it instead. So does
+        // one from a guess past twice the time: there the left side grows
+        // exponentially and Laguerre would only creep down it.
+        for(int iteration = 0; iteration < maxIterations; iteration++){
+            for(int l = 0; l < keplerLanes; l++){
+                arg[l] = beta[l] * s[l] * s[l];
+            }
+            stumpff(arg, c0, c1, c2, c3);
+
+            bool converged = true;
+            for(int l = 0; l < keplerLanes; l++){
+                double g1 = s[l] * c1[l];
+                double g2 = s[l] * s[l] * c2[l];
+                double g3 = s[l] * s[l] * s[l] * c3[l];
+                double f = r0[l] * g1 + eta[l] * g2 + mu * g3 - dt;
+                double df = r0[l] * c0[l] + eta[l] * g1 + mu * g2;
+                double ddf = eta[l] * c0[l] + zeta[l] * g1;
+
+                if (f < 0.0){
+                    lo[l] = s[l];
+                }
+                else{
+                    hi[l] = s[l];
+                }
+                double next = s[l] - 5.0 * f / (df + std::sqrt(std::abs(16.0 * df * df - 20.0 * f * ddf)));
+                if (!(next > lo[l] && next < hi[l]) || f > dt){
+                    next = hi[l] < std::numeric_limits<double>::infinity() ? 0.5 * (lo[l] + hi[l]) : 2.0 * s[l];
+                }
+
+                converged = converged && std::abs(next - s[l]) <= tolerance * std::abs(next);
+                s[l] = next;
+            }
+            if (converged){
+                break;
+            }
+        }
+
+        // f and g functions at the solution
+        for(int l = 0; l < keplerLanes; l++){
+            arg[l] = beta[l] * s[l] * s[l];
+        }
+        stumpff(arg, c0, c1, c2, c3);
+
+        for(int l = 0; l < lanes; l++){
+            double g1 = s[l] * c1[l];
+            double g2 = s[l] * s[l] * c2[l];
+            double r = r0[l] * c0[l] + eta[l] * g1 + mu * g2;
+
+            double f = 1.0 - mu * g2 / r0[l];
+            double g = r0[l] * g1 + eta[l] * g2;
+            double df = -mu * g1 / (r0[l] * r);
+            double dg = 1.0 - mu * g2 / r;
+
+            int k = base + l;
+            x[k] = f * px[l] + g * ux[l];
+            y[k] = f * py[l] + g * uy[l];
+            z[k] = f * pz[l] + g * uz[l];
+            vx[k] = df * px[l] + dg * ux[l];
+            vy[k] = df * py[l] + dg * uy[l];
+            vz[k] = df * pz[l] + dg * uz[l];
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+/*
+ * Exact two-body drift for the Wisdom-Holman integrator.
+ *
+ * Each body moves along its Kepler orbit about a fixed point mass at the
+ * origin, of gravitational parameter mu (SimParams::gConstant), for time
+ * dt: elliptic, parabolic or hyperbolic alike, in the universal variable
+ * s. Kepler's equation
+ *   r0 G1(s) + (r0 . v0) G2(s) + mu G3(s) = dt
+ * is solved with Laguerre's method from the guess dt / r0, falling back
+ * to bisection of the bracket around the root when a step leaves it, and
+ * the f and g functions of the solution give the new position and
+ * velocity. The G functions are s^k c_k(beta s^2) with
+ * beta = 2 mu / r0 - v0^2 and c_k the Stumpff functions, evaluated
+ * without trigonometry: the argument is quartered until a short series
+ * converges, then quadrupled back with the double-angle relations.
+ *
+ * Bodies go through in blocks of keplerLanes, every step of the solver
+ * applied to all lanes of a block in a plain loop (the same number of
+ * quarterings for all, iterations until the slowest lane converges), so
+ * the compiler vectorises the lanes.
+ */
+
+const int keplerLanes = 8;
+
+// Move count bodies, positions relative to the point mass, along their
+// orbits for dt. Positions and velocities are updated in place.
+void keplerDrift(double* x, double* y, double* z, double* vx, double* vy, double* vz, int count, double mu, double dt);
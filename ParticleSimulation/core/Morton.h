@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * 3D Morton (Z-order) keys: the bits of x, y and z interleaved so that
+ * points close in space tend to be close in key order.
+ */
+
+// Spread the low 21 bits of v so there are two zero bits between each
+inline uint64_t mortonSpread(uint32_t v){
+  uint64_t x = v & 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffULL;
+  x = (x | x << 16) & 0x1f0000ff0000ffULL;
+  x = (x | x << 8)  & 0x100f00f00f00f00fULL;
+  x = (x | x << 4)  & 0x10c30c30c30c30c3ULL;
+  x = (x | x << 2)  & 0x1249249249249249ULL;
+  return x;
+}
+
+// 63-bit key from three 21-bit cell coordinates, x in the lowest bit
+inline uint64_t mortonEncode(uint32_t x, uint32_t y, uint32_t z){
+  return mortonSpread(x) | (mortonSpread(y) << 1) | (mortonSpread(z) << 2);
+}
+
+static const int mortonBitsPerAxis = 21;
+static const uint32_t mortonMaxCoord = (1u << mortonBitsPerAxis) - 1;
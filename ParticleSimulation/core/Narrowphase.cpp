@@ -0,0 +1,32 @@
+#include "Narrowphase.h"
+#include "ParticlePhysics.h"
+#include "SimdKernels.h"
+
+void ContactBatch::flush(ParticleSystem& ps, const SimParams& params){
+    if (count == 0){
+        return;
+    }
+
+    // pad the unused lanes with a valid pair, their bits are masked off
+    for(int k = count; k < size; k++){
+        first[k] = first[0];
+        second[k] = second[0];
+    }
+
+    candidates += count;
+    int valid = (1 << count) - 1;
+
+    // Lanes are settled in order. A contact moves its two particles, so
+    // the later lanes sharing one of them were tested on stale positions
+    // and go to the exact per-pair check as well.
+    int pending = contactMask16(ps, first, second) & valid;
+    for(int k = 0; pending >> k; k++){
+        if (((pending >> k) & 1) && Particle3DCollision(ps, first[k], second[k], params)){
+            touched(first[k], second[k]);
+            int later = valid & ~((2 << k) - 1);
+            pending |= sharedLanes16(first, second, first[k], second[k]) & later;
+        }
+    }
+
+    count = 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ParticleSystem.h"
+#include <vector>
+
+/*
+ * Batched narrowphase between the broadphase and the collision response.
+ *
+ * Candidate pairs are collected 16 at a time and tested with one SIMD
+ * overlap check on squared distances (contactMask16), so the square root
+ * and the response only run for pairs that really touch. Contacts are
+ * resolved in the order the pairs were added; a later pair sharing a
+ * particle with one already resolved is checked again on the moved
+ * position. The result is therefore the same as calling
+ * Particle3DCollision on every candidate in turn.
+ *
+ * One batch per thread. Pairs of different blocks of a colour share no
+ * particles, so a batch may mix blocks, but it must be flushed before
+ * the colour pass ends.
+ */
+class ContactBatch{
+  public:
+    static const int size = 16;
+
+    // running totals, reset by the owner
+    long long candidates = 0;
+    long long contacts = 0;
+
+    // with recordPairs, every resolved pair is appended (i, j) to pairs
+    bool recordPairs = false;
+    std::vector<int> pairs;
+
+    void touched(int i, int j){
+      contacts++;
+      if (recordPairs){
+        pairs.push_back(i);
+        pairs.push_back(j);
+      }
+    }
+
+    void add(ParticleSystem& ps, const SimParams& params, int i, int j){
+      first[count] = i;
+      second[count] = j;
+      if (++count == size){
+        flush(ps, params);
+      }
+    }
+
+    // Test and resolve the pairs collected so far
+    void flush(ParticleSystem& ps, const SimParams& params);
+
+  private:
+    int first[size];
+    int second[size];
+    int count = 0;
+};
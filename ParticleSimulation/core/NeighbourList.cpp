@@ -0,0 +1,135 @@
+#include "NeighbourList.h"
+
+#include <algorithm>
+
+// grid cells per parallel-for chunk in the build passes
+static const int cellGrain = 64;
+
+bool NeighbourList::needsRebuild(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool){
+    if (!valid || (int)ps.size() != builtSize || (int)indices.size() != builtActive){
+        return true;
+    }
+
+    threadMax.assign(pool.size(), 0.0f);
+    pool.parallelForThreads(0, (int)indices.size(), 4096, [&](int begin, int end, int thread){
+        float largest = threadMax[thread];
+        for(int k = begin; k < end; k++){
+            int i = indices[k];
+            float dx = ps.px[i] - refX[i], dy = ps.py[i] - refY[i], dz = ps.pz[i] - refZ[i];
+            largest = std::max(largest, dx*dx + dy*dy + dz*dz);
+        }
+        threadMax[thread] = largest;
+    });
+
+    float largest = *std::max_element(threadMax.begin(), threadMax.end());
+    return largest > 0.25f * skin * skin;
+}
+
+void NeighbourList::build(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool){
+    int n = (int)ps.size();
+
+    float maxRadius = 0.0f;
+    for(int i : indices){
+        maxRadius = std::max(maxRadius, ps.radius[i]);
+    }
+    skin = skinFactor * maxRadius;
+
+    // cells of at least 2 * maxRadius + skin, so every listed pair is in
+    // the same or adjacent cells
+    grid.build(indices, [&](int i){ return ps.position(i); }, maxRadius + 0.5f * skin);
+
+    auto inReach = [&](int i, int j){
+        float dx = ps.px[i] - ps.px[j], dy = ps.py[i] - ps.py[j], dz = ps.pz[i] - ps.pz[j];
+        float reach = ps.radius[i] + ps.radius[j] + skin;
+        return dx*dx + dy*dy + dz*dz < reach * reach;
+    };
+
+    // One pass over the cells: accepted pairs go to the thread's buffer
+    // and are counted per row. A cell's pairs always have their first
+    // particle in that cell, so disjoint cells write disjoint rows.
+    if ((int)threadPairs.size() < pool.size()){
+        threadPairs.resize(pool.size());
+    }
+    for(std::vector<int>& pairs : threadPairs){
+        pairs.clear();
+    }
+
+    rowStart.assign(n + 1, 0);
+    pool.parallelForThreads(0, grid.cellCount(), cellGrain, [&](int begin, int end, int thread){
+        std::vector<int>& pairs = threadPairs[thread];
+        for(int c = begin; c < end; c++){
+            if (grid.cellStart[c] == grid.cellStart[c + 1]){
+                continue;
+            }
+            int x = c % grid.dimX, y = (c / grid.dimX) % grid.dimY, z = c / (grid.dimX * grid.dimY);
+            grid.forEachPairInCell(x, y, z, [&](int i, int j){
+                if (inReach(i, j)){
+                    pairs.push_back(i);
+                    pairs.push_back(j);
+                    rowStart[i + 1]++;
+                }
+            });
+        }
+    });
+
+    for(int i = 0; i < n; i++){
+        rowStart[i + 1] += rowStart[i];
+    }
+
+    // a row's pairs all sit in one buffer, in cell order, so the rows
+    // come out the same for any thread count
+    neighbours.resize(rowStart[n]);
+    cursor.assign(rowStart.begin(), rowStart.end() - 1);
+    pool.parallelFor(0, (int)threadPairs.size(), 1, [&](int first, int last){
+        for(int t = first; t < last; t++){
+            const std::vector<int>& pairs = threadPairs[t];
+            for(size_t p = 0; p < pairs.size(); p += 2){
+                neighbours[cursor[pairs[p]]++] = pairs[p + 1];
+            }
+        }
+    });
+
+    // batches: colour blocks with at least one non-empty row
+    batchParticles.clear();
+    batchStart.assign(1, 0);
+    for(int colour = 0; colour < numColours; colour++){
+        colourBatchStart[colour] = (int)batchStart.size() - 1;
+        for(int k = 0; k < grid.colourBlockCount(colour); k++){
+            grid.forEachCellInColourBlock(colour, k, [&](int x, int y, int z){
+                int c = grid.cellIndex(x, y, z);
+                for(int a = grid.cellStart[c]; a < grid.cellStart[c + 1]; a++){
+                    int i = grid.cellParticles[a];
+                    if (rowStart[i + 1] > rowStart[i]){
+                        batchParticles.push_back(i);
+                    }
+                }
+            });
+            if ((int)batchParticles.size() > batchStart.back()){
+                batchStart.push_back((int)batchParticles.size());
+            }
+        }
+    }
+    colourBatchStart[numColours] = (int)batchStart.size() - 1;
+
+    refX.resize(n); refY.resize(n); refZ.resize(n);
+    for(int i : indices){
+        refX[i] = ps.px[i];
+        refY[i] = ps.py[i];
+        refZ[i] = ps.pz[i];
+    }
+
+    builtSize = n;
+    builtActive = (int)indices.size();
+    valid = true;
+    rebuildCount++;
+    stepsSinceRebuild = 0;
+}
+
+bool NeighbourList::update(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool){
+    if (needsRebuild(ps, indices, pool)){
+        build(ps, indices, pool);
+        return true;
+    }
+    stepsSinceRebuild++;
+    return false;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "ParticleSystem.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+#include <vector>
+
+/*
+ * Verlet neighbour lists for the collision pass.
+ *
+ * Every pair closer than r_i + r_j + skin is stored once, in CSR form:
+ * the neighbours of particle i are neighbours[rowStart[i] .. rowStart[i+1]).
+ * While no particle has moved more than skin / 2 since the build, no
+ * pair outside the list can have come into contact, so the list is
+ * reused across steps and only rebuilt when that bound is crossed (or
+ * the particle set changed).
+ *
+ * The build runs over a uniform grid whose cells are wide enough for the
+ * skin. A pair is stored in the row of the particle whose cell owns it,
+ * so the grid's colour blocks still partition the rows into lock-free
+ * parallel batches. Only blocks with pairs are kept as batches, so a
+ * step without a rebuild costs in proportion to the stored pairs.
+ */
+class NeighbourList{
+  public:
+    // skin = skinFactor * largest radius
+    float skinFactor = 1.0f;
+
+    std::vector<int> rowStart;   // particle index -> first neighbour, size + 1 entries
+    std::vector<int> neighbours;
+
+    // statistics
+    long long rebuildCount = 0;
+    int stepsSinceRebuild = 0;
+
+    int pairCount() const { return (int)neighbours.size(); }
+
+    // Force a rebuild on the next update(), e.g. after the particles were reordered
+    void invalidate(){ valid = false; }
+
+    // Rebuild if any listed particle moved more than skin / 2 since the
+    // last build, or the particles changed. Returns true if it rebuilt.
+    bool update(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool);
+
+    static const int numColours = SpatialGrid::numColours;
+
+    // Batches are the grid's colour blocks that have at least one stored pair
+    int colourBatchCount(int colour) const { return colourBatchStart[colour + 1] - colourBatchStart[colour]; }
+
+    // Visit the stored pairs of the k-th batch of a colour
+    template <typename PairFn>
+    void forEachPairInColourBatch(int colour, int k, PairFn visit) const {
+      int batch = colourBatchStart[colour] + k;
+      for(int b = batchStart[batch]; b < batchStart[batch + 1]; b++){
+        int i = batchParticles[b];
+        for(int n = rowStart[i]; n < rowStart[i + 1]; n++){
+          visit(i, neighbours[n]);
+        }
+      }
+    }
+
+  private:
+    SpatialGrid grid;
+    bool valid = false;
+    float skin = 0.0f;
+    int builtSize = 0, builtActive = 0;
+
+    // positions at the last build, by particle index
+    std::vector<float> refX, refY, refZ;
+    std::vector<int> cursor;
+    std::vector<float> threadMax;
+
+    // particles with a non-empty row, grouped by batch, batches grouped by colour
+    std::vector<int> batchParticles;
+    std::vector<int> batchStart;
+    int colourBatchStart[numColours + 1] = {};
+
+    // accepted (i, j) pairs of the build, one buffer per thread
+    std::vector<std::vector<int>> threadPairs;
+
+    bool needsRebuild(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool);
+    void build(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool);
+};
@@ -0,0 +1,268 @@
+#include "Octree.h"
+#include "Morton.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Levels built serially before handing subtrees to the pool (up to 8^2 tasks)
+static const int topSplitLevel = 2;
+
+// Child octant of a key at the given level (level 0 is the root)
+static inline int octantAt(uint64_t key, int level){
+    return (int)((key >> (3 * (mortonBitsPerAxis - 1 - level))) & 7);
+}
+
+void Octree::summarise(OctreeNode& node, const OctreeNode* children){
+    double mass = 0.0, mx = 0.0, my = 0.0, mz = 0.0;
+
+    if (node.childCount == 0){
+        for(int s = node.begin; s < node.end; s++){
+            mass += sortedMass[s];
+            mx += (double)sortedMass[s] * sortedX[s];
+            my += (double)sortedMass[s] * sortedY[s];
+            mz += (double)sortedMass[s] * sortedZ[s];
+        }
+    }
+    else{
+        for(int c = 0; c < node.childCount; c++){
+            const OctreeNode& child = children[c];
+            mass += child.mass;
+            mx += (double)child.mass * child.comX;
+            my += (double)child.mass * child.comY;
+            mz += (double)child.mass * child.comZ;
+        }
+    }
+
+    node.mass = (float)mass;
+    if (mass > 0.0){
+        node.comX = (float)(mx / mass);
+        node.comY = (float)(my / mass);
+        node.comZ = (float)(mz / mass);
+    }
+    else{
+        node.comX = sortedX[node.begin];
+        node.comY = sortedY[node.begin];
+        node.comZ = sortedZ[node.begin];
+    }
+
+    // bounding sphere about the centre of mass, exact for leaves
+    float radius = 0.0f;
+    if (node.childCount == 0){
+        for(int s = node.begin; s < node.end; s++){
+            float dx = sortedX[s] - node.comX, dy = sortedY[s] - node.comY, dz = sortedZ[s] - node.comZ;
+            radius = std::max(radius, dx*dx + dy*dy + dz*dz);
+        }
+        radius = std::sqrt(radius);
+    }
+    else{
+        for(int c = 0; c < node.childCount; c++){
+            const OctreeNode& child = children[c];
+            float dx = child.comX - node.comX, dy = child.comY - node.comY, dz = child.comZ - node.comZ;
+            radius = std::max(radius, std::sqrt(dx*dx + dy*dy + dz*dz) + child.radius);
+        }
+    }
+    node.radius = radius;
+}
+
+// Recursively build the children of `node` into `pool`
+void Octree::buildNode(std::vector<OctreeNode>& pool, OctreeNode& node, int begin, int end, int level){
+    node.begin = begin;
+    node.end = end;
+    node.size = rootSize / (float)(1 << level);
+    node.firstChild = 0;
+    node.childCount = 0;
+
+    if (end - begin <= leafCapacity || level >= mortonBitsPerAxis){
+        summarise(node, nullptr);
+        return;
+    }
+
+    // split the sorted range by the next octant digit
+    int bounds[9];
+    bounds[0] = begin;
+    int cursor = begin;
+    for(int octant = 0; octant < 8; octant++){
+        while(cursor < end && octantAt(keys[cursor], level) == octant){
+            cursor++;
+        }
+        bounds[octant + 1] = cursor;
+    }
+
+    int firstChild = (int)pool.size();
+    int childCount = 0;
+    for(int octant = 0; octant < 8; octant++){
+        if (bounds[octant + 1] > bounds[octant]){
+            childCount++;
+        }
+    }
+    pool.resize(pool.size() + childCount);
+
+    int c = 0;
+    for(int octant = 0; octant < 8; octant++){
+        if (bounds[octant + 1] > bounds[octant]){
+            // pool may grow inside the call, so copy out and back
+            OctreeNode child;
+            buildNode(pool, child, bounds[octant], bounds[octant + 1], level + 1);
+            pool[firstChild + c] = child;
+            c++;
+        }
+    }
+
+    node.firstChild = firstChild;
+    node.childCount = childCount;
+    summarise(node, &pool[firstChild]);
+}
+
+// Serially expand the top levels, queueing subtrees for the pool
+void Octree::splitTop(int node, int begin, int end, int level, int splitLevel){
+    OctreeNode& n = nodes[node];
+    n.begin = begin;
+    n.end = end;
+    n.size = rootSize / (float)(1 << level);
+    n.firstChild = 0;
+    n.childCount = 0;
+
+    if (level >= splitLevel || end - begin <= leafCapacity){
+        tasks.push_back({ node, begin, end, level });
+        return;
+    }
+
+    int bounds[9];
+    bounds[0] = begin;
+    int cursor = begin;
+    for(int octant = 0; octant < 8; octant++){
+        while(cursor < end && octantAt(keys[cursor], level) == octant){
+            cursor++;
+        }
+        bounds[octant + 1] = cursor;
+    }
+
+    int firstChild = (int)nodes.size();
+    int childCount = 0;
+    for(int octant = 0; octant < 8; octant++){
+        if (bounds[octant + 1] > bounds[octant]){
+            childCount++;
+        }
+    }
+    nodes.resize(nodes.size() + childCount);
+    nodes[node].firstChild = firstChild;
+    nodes[node].childCount = childCount;
+
+    int c = 0;
+    for(int octant = 0; octant < 8; octant++){
+        if (bounds[octant + 1] > bounds[octant]){
+            splitTop(firstChild + c, bounds[octant], bounds[octant + 1], level + 1, splitLevel);
+            c++;
+        }
+    }
+}
+
+// Mass moments of the serial top levels, after the subtrees are in place
+void Octree::finishTop(int node){
+    OctreeNode& n = nodes[node];
+    if (isTaskNode[node]){
+        return;
+    }
+    for(int c = 0; c < n.childCount; c++){
+        finishTop(n.firstChild + c);
+    }
+    summarise(nodes[node], &nodes[n.firstChild]);
+}
+
+void Octree::build(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool){
+    int n = (int)indices.size();
+    nodes.clear();
+    subtreeRoots.clear();
+    if (n == 0){
+        return;
+    }
+
+    const int grain = 4096;
+
+    // bounding cube
+    glm::vec3 lo(ps.px[indices[0]], ps.py[indices[0]], ps.pz[indices[0]]);
+    glm::vec3 hi = lo;
+    for(int i : indices){
+        glm::vec3 p(ps.px[i], ps.py[i], ps.pz[i]);
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    rootSize = std::max(std::max(hi.x - lo.x, hi.y - lo.y), std::max(hi.z - lo.z, 1e-3f)) * 1.0001f;
+    float toGrid = (float)mortonMaxCoord / rootSize;
+
+    // Morton keys and sort
+    keys.resize(n);
+    order.resize(n);
+    pool.parallelFor(0, n, grain, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            int i = indices[k];
+            uint32_t x = (uint32_t)((ps.px[i] - lo.x) * toGrid);
+            uint32_t y = (uint32_t)((ps.py[i] - lo.y) * toGrid);
+            uint32_t z = (uint32_t)((ps.pz[i] - lo.z) * toGrid);
+            keys[k] = mortonEncode(std::min(x, mortonMaxCoord), std::min(y, mortonMaxCoord), std::min(z, mortonMaxCoord));
+            order[k] = i;
+        }
+    });
+    sorter.sort(keys, order, 3 * mortonBitsPerAxis, pool);
+
+    sortedX.resize(n); sortedY.resize(n); sortedZ.resize(n); sortedMass.resize(n);
+    pool.parallelFor(0, n, grain, [&](int begin, int end){
+        for(int s = begin; s < end; s++){
+            int i = order[s];
+            sortedX[s] = ps.px[i];
+            sortedY[s] = ps.py[i];
+            sortedZ[s] = ps.pz[i];
+            sortedMass[s] = ps.mass[i];
+        }
+    });
+
+    // top levels serially, subtrees in parallel
+    tasks.clear();
+    nodes.resize(1);
+    splitTop(0, 0, n, 0, topSplitLevel);
+
+    isTaskNode.assign(nodes.size(), 0);
+    subtreeRoots.clear();
+    for(const SubtreeTask& t : tasks){
+        isTaskNode[t.node] = 1;
+        subtreeRoots.push_back(t.node);
+    }
+
+    if (subtreePools.size() < tasks.size()){
+        subtreePools.resize(tasks.size());
+    }
+
+    pool.parallelFor(0, (int)tasks.size(), 1, [&](int first, int last){
+        for(int t = first; t < last; t++){
+            std::vector<OctreeNode>& local = subtreePools[t];
+            local.clear();
+            buildNode(local, nodes[tasks[t].node], tasks[t].begin, tasks[t].end, tasks[t].level);
+        }
+    });
+
+    // splice the subtree pools behind the top levels
+    subtreeOffsets.resize(tasks.size());
+    int total = (int)nodes.size();
+    for(size_t t = 0; t < tasks.size(); t++){
+        subtreeOffsets[t] = total;
+        total += (int)subtreePools[t].size();
+    }
+    nodes.resize(total);
+
+    pool.parallelFor(0, (int)tasks.size(), 1, [&](int first, int last){
+        for(int t = first; t < last; t++){
+            int offset = subtreeOffsets[t];
+            const std::vector<OctreeNode>& local = subtreePools[t];
+            for(size_t k = 0; k < local.size(); k++){
+                OctreeNode node = local[k];
+                node.firstChild += offset;
+                nodes[offset + k] = node;
+            }
+            nodes[tasks[t].node].firstChild += offset;
+        }
+    });
+
+    isTaskNode.resize(nodes.size(), 0);
+
+    finishTop(0);
+}
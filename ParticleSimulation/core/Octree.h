@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ParticleSystem.h"
+#include "RadixSort.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+/*
+ * Adaptive octree over Morton-sorted particles, shared by the tree
+ * gravity solvers.
+ *
+ * The tree is rebuilt every step: each node owns a contiguous range of
+ * the sorted order, and its children are stored next to each other.
+ * Cells are split until they hold at most leafCapacity particles, so the
+ * depth follows the local density. The top levels are split serially,
+ * the subtrees below them are built in parallel into per-subtree pools
+ * and then spliced into one node array. All node and scratch storage is
+ * kept between steps, so once warmed up a rebuild does no allocation.
+ */
+
+struct OctreeNode{
+  float comX, comY, comZ, mass;
+  float size;                 // edge length of the cubic cell
+  float radius;               // bounding sphere of the particles about the centre of mass
+  int firstChild, childCount; // childCount == 0 for leaves
+  int begin, end;             // range in the sorted particle order
+};
+
+class Octree{
+  public:
+    int leafCapacity = 16;
+
+    // node array of the last build, root at index 0
+    std::vector<OctreeNode> nodes;
+
+    // roots of the subtrees built in parallel; they partition the particles
+    // and each subtree occupies its own nodes, so solvers can use them as
+    // independent tasks
+    std::vector<int> subtreeRoots;
+
+    // Sorted particle data of the last build
+    std::vector<int> order;                     // sorted slot -> particle index
+    std::vector<float> sortedX, sortedY, sortedZ, sortedMass;
+
+    void build(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool);
+
+    bool isSubtreeRoot(int node) const { return isTaskNode[node] != 0; }
+
+  private:
+    struct SubtreeTask{ int node, begin, end, level; };
+
+    std::vector<uint64_t> keys;
+    RadixSorter sorter;
+    std::vector<SubtreeTask> tasks;
+    std::vector<char> isTaskNode;
+    std::vector<std::vector<OctreeNode>> subtreePools;
+    std::vector<int> subtreeOffsets;             // where each pool is spliced into nodes
+
+    float rootSize = 0.0f;
+
+    void splitTop(int node, int begin, int end, int level, int splitLevel);
+    void buildNode(std::vector<OctreeNode>& pool, OctreeNode& node, int begin, int end, int level);
+    void summarise(OctreeNode& node, const OctreeNode* children);
+    void finishTop(int node);
+};
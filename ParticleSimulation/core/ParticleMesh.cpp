@@ -0,0 +1,214 @@
+#include "ParticleMesh.h"
+
+#include <algorithm>
+#include <cmath>
+
+void ParticleMesh::prepareGreen(float cellSize, float softening, ThreadPool& pool){
+    int m = gridSize;
+    int n = 2 * m;
+
+    if (cellSize == greenCellSize && softening == greenSoftening && m == greenGridSize){
+        return;
+    }
+
+    // -1 / sqrt(r^2 + eps^2) with wrap-around distances on the padded grid
+    float eps = std::max(softening, 0.5f * cellSize);
+    green.assign((size_t)n * n * n, Complex(0.0f, 0.0f));
+
+    pool.parallelFor(0, n, 1, [&](int begin, int end){
+        for(int z = begin; z < end; z++){
+            float dz = (float)std::min(z, n - z) * cellSize;
+            for(int y = 0; y < n; y++){
+                float dy = (float)std::min(y, n - y) * cellSize;
+                for(int x = 0; x < n; x++){
+                    float dx = (float)std::min(x, n - x) * cellSize;
+                    float r2 = dx*dx + dy*dy + dz*dz + eps*eps;
+                    green[((size_t)z * n + y) * n + x] = Complex(-1.0f / std::sqrt(r2), 0.0f);
+                }
+            }
+        }
+    });
+
+    fft3d(green, plan, false, pool);
+
+    greenCellSize = cellSize;
+    greenSoftening = softening;
+    greenGridSize = m;
+}
+
+void ParticleMesh::computeAccelerations(ParticleSystem& ps, const std::vector<int>& indices, float G, float softening, ThreadPool& pool){
+    int count = (int)indices.size();
+    if (count == 0){
+        return;
+    }
+
+    int m = gridSize;
+    int n = 2 * m;
+    plan.prepare(n);
+
+    const int grain = 4096;
+
+    // bounding cube, padded so every CIC stencil stays inside the mesh
+    glm::vec3 lo(ps.px[indices[0]], ps.py[indices[0]], ps.pz[indices[0]]);
+    glm::vec3 hi = lo;
+    for(int i : indices){
+        glm::vec3 p(ps.px[i], ps.py[i], ps.pz[i]);
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    float extent = std::max(std::max(hi.x - lo.x, hi.y - lo.y), std::max(hi.z - lo.z, 1e-3f));
+
+    // quantise the cell size to powers of 2^(1/4) so the Green's function is reused
+    float cellSize = extent / (float)(m - 3);
+    cellSize = std::pow(2.0f, std::ceil(4.0f * std::log2(cellSize)) / 4.0f);
+    glm::vec3 origin = 0.5f * (lo + hi) - glm::vec3(0.5f * (m - 1) * cellSize);
+    float toCell = 1.0f / cellSize;
+
+    prepareGreen(cellSize, softening, pool);
+
+    // bucket the particles by the pair of z-slabs their stencil starts in,
+    // with per-block histograms so the scatter is parallel and stable
+    int numSlabPairs = (m + 1) / 2;
+    int numBlocks = (count + grain - 1) / grain;
+    particleSlab.resize(count);
+    slabCursor.assign((size_t)numBlocks * numSlabPairs, 0);
+    pool.parallelFor(0, numBlocks, 1, [&](int first, int last){
+        for(int b = first; b < last; b++){
+            int* histogram = &slabCursor[(size_t)b * numSlabPairs];
+            int end = std::min(count, (b + 1) * grain);
+            for(int k = b * grain; k < end; k++){
+                int iz = (int)std::floor((ps.pz[indices[k]] - origin.z) * toCell);
+                particleSlab[k] = std::min(std::max(iz, 0), m - 2) / 2;
+                histogram[particleSlab[k]]++;
+            }
+        }
+    });
+
+    // offsets in (slab, block) order
+    slabStart.resize(numSlabPairs + 1);
+    int offset = 0;
+    for(int s = 0; s < numSlabPairs; s++){
+        slabStart[s] = offset;
+        for(int b = 0; b < numBlocks; b++){
+            int& slot = slabCursor[(size_t)b * numSlabPairs + s];
+            int blockCount = slot;
+            slot = offset;
+            offset += blockCount;
+        }
+    }
+    slabStart[numSlabPairs] = offset;
+
+    slabOrder.resize(count);
+    pool.parallelFor(0, numBlocks, 1, [&](int first, int last){
+        for(int b = first; b < last; b++){
+            int* cursor = &slabCursor[(size_t)b * numSlabPairs];
+            int end = std::min(count, (b + 1) * grain);
+            for(int k = b * grain; k < end; k++){
+                slabOrder[cursor[particleSlab[k]]++] = indices[k];
+            }
+        }
+    });
+
+    // CIC deposit; pair s writes slabs 2s..2s+2, so even and odd pairs
+    // are each race free. The mesh is cleared slab by slab in parallel.
+    size_t total = (size_t)n * n * n;
+    density.resize(total);
+    pool.parallelFor(0, n, 1, [&](int begin, int end){
+        std::fill(density.begin() + (size_t)begin * n * n, density.begin() + (size_t)end * n * n, Complex(0.0f, 0.0f));
+    });
+
+    for(int colour = 0; colour < 2; colour++){
+        int pairs = (numSlabPairs - colour + 1) / 2;
+        pool.parallelFor(0, pairs, 1, [&](int first, int last){
+            for(int p = first; p < last; p++){
+                int s = 2 * p + colour;
+                for(int k = slabStart[s]; k < slabStart[s + 1]; k++){
+                    int i = slabOrder[k];
+                    float gx = (ps.px[i] - origin.x) * toCell;
+                    float gy = (ps.py[i] - origin.y) * toCell;
+                    float gz = (ps.pz[i] - origin.z) * toCell;
+
+                    int ix = std::min(std::max((int)std::floor(gx), 0), m - 2);
+                    int iy = std::min(std::max((int)std::floor(gy), 0), m - 2);
+                    int iz = std::min(std::max((int)std::floor(gz), 0), m - 2);
+                    float fx = gx - ix, fy = gy - iy, fz = gz - iz;
+
+                    float mass = ps.mass[i];
+                    for(int c = 0; c < 8; c++){
+                        int ox = c & 1, oy = (c >> 1) & 1, oz = (c >> 2) & 1;
+                        float w = (ox ? fx : 1.0f - fx) * (oy ? fy : 1.0f - fy) * (oz ? fz : 1.0f - fz);
+                        density[((size_t)(iz + oz) * n + (iy + oy)) * n + (ix + ox)] += Complex(mass * w, 0.0f);
+                    }
+                }
+            }
+        });
+    }
+
+    // potential = G * IFFT(FFT(density) * FFT(green)) / n^3
+    fft3d(density, plan, false, pool, m);
+
+    pool.parallelFor(0, n, 1, [&](int begin, int end){
+        for(size_t k = (size_t)begin * n * n; k < (size_t)end * n * n; k++){
+            density[k] *= green[k];
+        }
+    });
+
+    fft3d(density, plan, true, pool, m);
+    float potentialScale = G / (float)total;
+
+    // acceleration = -grad(potential) on the unpadded mesh
+    fieldX.resize((size_t)m * m * m);
+    fieldY.resize((size_t)m * m * m);
+    fieldZ.resize((size_t)m * m * m);
+
+    auto potential = [&](int x, int y, int z){
+        return density[((size_t)z * n + y) * n + x].real() * potentialScale;
+    };
+
+    pool.parallelFor(0, m, 1, [&](int begin, int end){
+        for(int z = begin; z < end; z++){
+            for(int y = 0; y < m; y++){
+                for(int x = 0; x < m; x++){
+                    // central differences, one-sided at the mesh edge
+                    int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, m - 1);
+                    int y0 = std::max(y - 1, 0), y1 = std::min(y + 1, m - 1);
+                    int z0 = std::max(z - 1, 0), z1 = std::min(z + 1, m - 1);
+
+                    size_t cell = ((size_t)z * m + y) * m + x;
+                    fieldX[cell] = -(potential(x1, y, z) - potential(x0, y, z)) / ((x1 - x0) * cellSize);
+                    fieldY[cell] = -(potential(x, y1, z) - potential(x, y0, z)) / ((y1 - y0) * cellSize);
+                    fieldZ[cell] = -(potential(x, y, z1) - potential(x, y, z0)) / ((z1 - z0) * cellSize);
+                }
+            }
+        }
+    });
+
+    // CIC interpolation back to the particles
+    pool.parallelFor(0, count, grain, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            int i = indices[k];
+            float gx = (ps.px[i] - origin.x) * toCell;
+            float gy = (ps.py[i] - origin.y) * toCell;
+            float gz = (ps.pz[i] - origin.z) * toCell;
+
+            int ix = std::min(std::max((int)std::floor(gx), 0), m - 2);
+            int iy = std::min(std::max((int)std::floor(gy), 0), m - 2);
+            int iz = std::min(std::max((int)std::floor(gz), 0), m - 2);
+            float fx = gx - ix, fy = gy - iy, fz = gz - iz;
+
+            float ax = 0.0f, ay = 0.0f, az = 0.0f;
+            for(int c = 0; c < 8; c++){
+                int ox = c & 1, oy = (c >> 1) & 1, oz = (c >> 2) & 1;
+                float w = (ox ? fx : 1.0f - fx) * (oy ? fy : 1.0f - fy) * (oz ? fz : 1.0f - fz);
+                size_t cell = ((size_t)(iz + oz) * m + (iy + oy)) * m + (ix + ox);
+                ax += w * fieldX[cell];
+                ay += w * fieldY[cell];
+                az += w * fieldZ[cell];
+            }
+
+            ps.ax[i] = ax;
+            ps.ay[i] = ay;
+            ps.az[i] = az;
+        }
+    });
+}
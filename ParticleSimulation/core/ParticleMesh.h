@@ -0,0 +1,50 @@
+#pragma once
+
+#include "FFT.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+#include <vector>
+
+/*
+ * Particle-mesh (PM) mutual gravity.
+ *
+ * Masses are deposited onto a gridSize^3 mesh with cloud-in-cell (CIC)
+ * weights. The potential is the convolution of that density with a
+ * softened Green's function, done with FFTs on a grid padded to twice
+ * the size so the system is isolated rather than periodic. Accelerations
+ * are central differences of the potential, interpolated back to the
+ * particles with the same CIC weights.
+ *
+ * The mesh is a cube around the particles; its cell size is rounded up to
+ * a power of 2^(1/4) so the transformed Green's function can be reused
+ * while the cloud keeps roughly the same size. Forces are smoothed on the
+ * scale of a cell (the effective softening is at least half a cell).
+ *
+ * Particles are bucketed by z-slab with a parallel, stable counting sort.
+ * Deposition runs in parallel over pairs of z-slabs in two colours, so no
+ * two threads write the same cell and the result does not depend on the
+ * thread count. Interpolation is read-only and fully parallel.
+ */
+class ParticleMesh{
+  public:
+    int gridSize = 64; // cells per axis, power of two
+
+    // Overwrite ps.ax/ay/az of the listed particles with their mutual gravity
+    void computeAccelerations(ParticleSystem& ps, const std::vector<int>& indices, float G, float softening, ThreadPool& pool);
+
+  private:
+    FFTPlan plan;
+    std::vector<Complex> density;   // padded (2 * gridSize)^3, reused for the potential
+    std::vector<Complex> green;     // transformed Green's function
+    float greenCellSize = 0.0f;
+    float greenSoftening = -1.0f;
+    int greenGridSize = 0;
+
+    std::vector<float> fieldX, fieldY, fieldZ; // gridSize^3 accelerations
+
+    // particles bucketed by z-slab pair for the coloured deposit
+    std::vector<int> slabStart, slabOrder, particleSlab;
+    std::vector<int> slabCursor; // per-block slab histograms, then scatter offsets
+
+    void prepareGreen(float cellSize, float softening, ThreadPool& pool);
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "ParticleSystem.h"
+#include <glm/glm.hpp>
+#include <cmath>
+
+/*
+ * Per-particle physics on the SoA ParticleSystem.
+ *
+ * These mirror the Particle3D methods one-to-one; the shared
+ * constants (damping, attractor, boundary) come from SimParams.
+ */
+
+inline void SetGravity(ParticleSystem& ps, int i, const SimParams& params){
+
+    glm::vec3 direction = params.gravityCenter - ps.position(i);
+    float distance = glm::length(direction);
+
+    direction = glm::normalize(direction);
+
+    if (distance < params.minGravityDistance){
+        distance = params.minGravityDistance;
+    }
+
+    float accelMagnitude = params.gConstant / (distance * distance);
+
+    ps.ax[i] += direction.x * accelMagnitude;
+    ps.ay[i] += direction.y * accelMagnitude;
+    ps.az[i] += direction.z * accelMagnitude;
+}
+
+inline void VerletIntegration(ParticleSystem& ps, int i, float deltaTime, const SimParams& params){
+
+    float halfDt2 = 0.5f * deltaTime * deltaTime;
+    ps.px[i] += ps.vx[i] * deltaTime + ps.ax[i] * halfDt2;
+    ps.py[i] += ps.vy[i] * deltaTime + ps.ay[i] * halfDt2;
+    ps.pz[i] += ps.vz[i] * deltaTime + ps.az[i] * halfDt2;
+
+    glm::vec3 oldAcceleration = ps.acceleration(i);
+
+    ps.setAcceleration(i, glm::vec3(0.0f));
+
+    SetGravity(ps, i, params);
+
+    ps.vx[i] += 0.5f * (oldAcceleration.x + ps.ax[i]) * deltaTime;
+    ps.vy[i] += 0.5f * (oldAcceleration.y + ps.ay[i]) * deltaTime;
+    ps.vz[i] += 0.5f * (oldAcceleration.z + ps.az[i]) * deltaTime;
+}
+
+inline void checkSphereCollision(ParticleSystem& ps, int i, const SimParams& params){
+
+    glm::vec3 position = ps.position(i);
+    float distance = glm::length(position);
+
+    if(distance + ps.radius[i] >= params.boundaryRadius)
+    {
+        glm::vec3 normal = glm::normalize(position);
+        glm::vec3 velocity = ps.velocity(i);
+
+        velocity = velocity - 2.0f * glm::dot(velocity, normal) * normal;
+        ps.setVelocity(i, velocity * params.damping);
+        ps.setPosition(i, normal * (params.boundaryRadius - ps.radius[i]));
+    }
+}
+
+// checkSphereCollision for a particle that moved from `start` during a
+// step of deltaTime: if its path (taken as straight) crossed the boundary,
+// it is reflected where it met it and spends the rest of the step moving
+// along the reflected velocity, instead of being put back where it ended.
+inline void checkSweptSphereCollision(ParticleSystem& ps, int i, glm::vec3 start, float deltaTime, const SimParams& params){
+
+    float reach = params.boundaryRadius - ps.radius[i];
+    if(glm::length(ps.position(i)) < reach) return;
+
+    glm::vec3 path = ps.position(i) - start;
+    float a = glm::dot(path, path);
+    float b = 2.0f * glm::dot(start, path);
+    float c = glm::dot(start, start) - reach * reach;
+
+    // started on or outside the boundary: nothing to sweep
+    if(c >= 0.0f || a <= 0.0f){
+        checkSphereCollision(ps, i, params);
+        return;
+    }
+
+    // the root leaving the sphere, in (0, 1] as c < 0
+    float t = (-b + std::sqrt(b * b - 4.0f * a * c)) / (2.0f * a);
+    glm::vec3 contact = start + path * t;
+    glm::vec3 normal = glm::normalize(contact);
+    glm::vec3 velocity = ps.velocity(i);
+
+    velocity = (velocity - 2.0f * glm::dot(velocity, normal) * normal) * params.damping;
+    ps.setVelocity(i, velocity);
+    ps.setPosition(i, contact + velocity * ((1.0f - t) * deltaTime));
+
+    // a grazing path can still end outside
+    glm::vec3 position = ps.position(i);
+    if(glm::length(position) > reach){
+        ps.setPosition(i, glm::normalize(position) * reach);
+    }
+}
+
+// Returns true if the particles overlapped and were pushed apart
+inline bool Particle3DCollision(ParticleSystem& ps, int i, int j, const SimParams& params){
+
+    glm::vec3 delta = ps.position(j) - ps.position(i);
+    float distance = glm::length(delta);
+    float minDistance = ps.radius[i] + ps.radius[j];
+
+    if(distance < minDistance){
+
+      glm::vec3 temp = ps.velocity(i);
+      ps.setVelocity(i, ps.velocity(j) * params.damping);
+      ps.setVelocity(j, temp * params.damping);
+
+      glm::vec3 normal = glm::normalize(delta);
+      float overlap = minDistance - distance;
+
+      ps.setPosition(i, ps.position(i) - normal * (overlap * 0.5f));
+      ps.setPosition(j, ps.position(j) + normal * (overlap * 0.5f));
+      return true;
+    }
+    return false;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/*
+ * Structure-of-arrays particle store.
+ *
+ * Every attribute lives in its own 64-byte aligned column so a pass
+ * only pulls the fields it touches through the cache, and the x/y/z
+ * columns can be streamed by SIMD kernels without gathers.
+ */
+
+template <typename T, std::size_t Alignment = 64>
+struct AlignedAllocator{
+  using value_type = T;
+
+  template <typename U>
+  struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+  AlignedAllocator() = default;
+
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&){}
+
+  T* allocate(std::size_t n){
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+  }
+
+  void deallocate(T* p, std::size_t){
+    ::operator delete(p, std::align_val_t(Alignment));
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+
+  template <typename U>
+  bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Constants shared by every particle (previously copied into each Particle3D)
+struct SimParams{
+  float damping = 0.96f;
+  float boundaryRadius = 400.0f;
+
+  // false leaves the domain open: particles are not kept inside boundaryRadius
+  bool sphereBoundary = true;
+
+  // central attractor used by SetGravity
+  glm::vec3 gravityCenter = glm::vec3(0.0f, -400.0f, 0.0f);
+  float gConstant = 7000000.0f;
+  float minGravityDistance = 5.0f;
+
+  // mutual particle-particle gravity (GravityMode other than CentralAttractor)
+  float mutualG = 1.0f;
+  float softeningLength = 2.0f;
+};
+
+class ParticleSystem{
+  public:
+    AlignedVector<float> px, py, pz;
+    AlignedVector<float> vx, vy, vz;
+    AlignedVector<float> ax, ay, az;
+    AlignedVector<float> mass, radius;
+
+    // Stable ids. Passes that reorder the columns move id along with the
+    // particle, so id[i] is the particle now at index i and indexOf(id)
+    // finds it again. Ids are the index a particle was added at.
+    std::vector<int> id;
+    std::vector<int> idToIndex;
+
+    std::size_t size() const { return px.size(); }
+
+    int indexOf(int particleId) const { return idToIndex[particleId]; }
+
+    void reserve(std::size_t n){
+      for(auto* column : columns()){
+        column->reserve(n);
+      }
+      id.reserve(n);
+      idToIndex.reserve(n);
+    }
+
+    void clear(){
+      for(auto* column : columns()){
+        column->clear();
+      }
+      id.clear();
+      idToIndex.clear();
+    }
+
+    // Append a particle and return its index, which is also its id
+    int add(glm::vec3 pos, glm::vec3 vel, float m, float r){
+      id.push_back((int)size());
+      idToIndex.push_back((int)size());
+
+      px.push_back(pos.x); py.push_back(pos.y); pz.push_back(pos.z);
+      vx.push_back(vel.x); vy.push_back(vel.y); vz.push_back(vel.z);
+
+      // same starting acceleration Particle3D used
+      ax.push_back(0.0f); ay.push_back(-98.0f); az.push_back(0.0f);
+
+      mass.push_back(m);
+      radius.push_back(r);
+      return (int)size() - 1;
+    }
+
+    glm::vec3 position(int i) const { return glm::vec3(px[i], py[i], pz[i]); }
+    glm::vec3 velocity(int i) const { return glm::vec3(vx[i], vy[i], vz[i]); }
+    glm::vec3 acceleration(int i) const { return glm::vec3(ax[i], ay[i], az[i]); }
+
+    void setPosition(int i, glm::vec3 p){ px[i] = p.x; py[i] = p.y; pz[i] = p.z; }
+    void setVelocity(int i, glm::vec3 v){ vx[i] = v.x; vy[i] = v.y; vz[i] = v.z; }
+    void setAcceleration(int i, glm::vec3 a){ ax[i] = a.x; ay[i] = a.y; az[i] = a.z; }
+
+    // All float columns, for passes that must touch every attribute
+    std::vector<AlignedVector<float>*> columns(){
+      return { &px, &py, &pz, &vx, &vy, &vz, &ax, &ay, &az, &mass, &radius };
+    }
+};
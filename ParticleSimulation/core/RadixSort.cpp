@@ -0,0 +1,71 @@
+#include "RadixSort.h"
+
+#include <algorithm>
+
+void RadixSorter::sort(std::vector<uint64_t>& keys, std::vector<int>& values, int keyBits, ThreadPool& pool){
+    const int radix = 256;
+    int n = (int)keys.size();
+    if (n < 2){
+        return;
+    }
+
+    // fixed blocks so histogram and scatter see the same partition
+    int numBlocks = std::min(n, pool.size() * 4);
+    int blockSize = (n + numBlocks - 1) / numBlocks;
+    numBlocks = (n + blockSize - 1) / blockSize;
+
+    keyScratch.resize(n);
+    valueScratch.resize(n);
+    histograms.resize((size_t)numBlocks * radix);
+
+    for(int shift = 0; shift < keyBits; shift += 8){
+
+        std::fill(histograms.begin(), histograms.end(), 0);
+
+        pool.parallelFor(0, numBlocks, 1, [&](int first, int last){
+            for(int b = first; b < last; b++){
+                int* histogram = &histograms[(size_t)b * radix];
+                int end = std::min(n, (b + 1) * blockSize);
+                for(int i = b * blockSize; i < end; i++){
+                    histogram[(keys[i] >> shift) & 0xff]++;
+                }
+            }
+        });
+
+        // offsets in (digit, block) order keep the scatter stable
+        int total = 0;
+        bool trivial = false;
+        for(int digit = 0; digit < radix; digit++){
+            int digitTotal = 0;
+            for(int b = 0; b < numBlocks; b++){
+                int& slot = histograms[(size_t)b * radix + digit];
+                int count = slot;
+                slot = total + digitTotal;
+                digitTotal += count;
+            }
+            if (digitTotal == n){
+                trivial = true;
+            }
+            total += digitTotal;
+        }
+
+        if (trivial){
+            continue;
+        }
+
+        pool.parallelFor(0, numBlocks, 1, [&](int first, int last){
+            for(int b = first; b < last; b++){
+                int* offsets = &histograms[(size_t)b * radix];
+                int end = std::min(n, (b + 1) * blockSize);
+                for(int i = b * blockSize; i < end; i++){
+                    int slot = offsets[(keys[i] >> shift) & 0xff]++;
+                    keyScratch[slot] = keys[i];
+                    valueScratch[slot] = values[i];
+                }
+            }
+        });
+
+        keys.swap(keyScratch);
+        values.swap(valueScratch);
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+/*
+ * Parallel LSD radix sort of (key, value) pairs.
+ *
+ * Sorts by the low keyBits bits of each key, 8 bits per pass. The array
+ * is split into fixed blocks; every pass builds one histogram per block
+ * in parallel, turns them into scatter offsets, then scatters each block
+ * in parallel. The sort is stable, and passes in which every key has the
+ * same digit are skipped. Scratch buffers are kept between calls.
+ */
+class RadixSorter{
+  public:
+    void sort(std::vector<uint64_t>& keys, std::vector<int>& values, int keyBits, ThreadPool& pool);
+
+  private:
+    std::vector<uint64_t> keyScratch;
+    std::vector<int> valueScratch;
+    std::vector<int> histograms;
+};
@@ -0,0 +1,180 @@
+#include "Scenes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+void addFountainScene(Simulation& sim, int numParticles, float spawnDelay){
+
+    //initialize Particle
+    glm::vec3 position(0.0f, 200.0f, 0.0f);
+
+    // spherical rotation and direction
+    const float magnitude = 400.0f;
+    const float anglePhi = glm::radians(-90.0f);
+    const float angleTheta = glm::radians(1.0f);
+
+    // for rotational and directional control
+    float directionX = magnitude*(cos(anglePhi)*cos(angleTheta));
+    float directionY = magnitude*(sin(anglePhi)*sin(angleTheta));
+    float directionZ = magnitude*(sin(angleTheta));
+
+    glm::vec3 velocity = glm::vec3(directionX, directionY, directionZ);
+
+    // variables for particle initialization
+    const float mass = 30.0f;
+    const float radius = 10.0f;
+
+    sim.particles.reserve(sim.particles.size() + numParticles);
+    for(int i = 0; i < numParticles; i++){
+        sim.addParticle(position, velocity, mass, radius, i * spawnDelay);
+    }
+}
+
+void addCloudScene(Simulation& sim, int numParticles, float particleRadius, uint32_t seed){
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    const float mass = 30.0f;
+    float extent = sim.params.boundaryRadius - particleRadius;
+
+    sim.particles.reserve(sim.particles.size() + numParticles);
+    for(int i = 0; i < numParticles; i++){
+
+        // rejection sample a point inside the unit ball
+        glm::vec3 p;
+        do{
+            p = glm::vec3(unit(gen), unit(gen), unit(gen));
+        } while(glm::dot(p, p) > 1.0f);
+
+        sim.addParticle(p * extent, glm::vec3(0.0f), mass, particleRadius);
+    }
+}
+
+void addPolydisperseScene(Simulation& sim, int numParticles, float minRadius, float maxRadius, uint32_t seed){
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    const float mass = 30.0f;
+
+    // inverse CDF of r^-3.5 on [minRadius, maxRadius]
+    const double power = -2.5;
+    double lo = std::pow((double)minRadius, power), hi = std::pow((double)maxRadius, power);
+
+    sim.particles.reserve(sim.particles.size() + numParticles);
+    for(int i = 0; i < numParticles; i++){
+        float radius = (float)std::pow(lo + uniform(gen) * (hi - lo), 1.0 / power);
+        float extent = sim.params.boundaryRadius - radius;
+
+        glm::vec3 p;
+        do{
+            p = glm::vec3(unit(gen), unit(gen), unit(gen));
+        } while(glm::dot(p, p) > 1.0f);
+
+        float scale = radius / minRadius;
+        sim.addParticle(p * extent, glm::vec3(0.0f), mass * scale * scale * scale, radius);
+    }
+}
+
+void addExplosionScene(Simulation& sim, int numParticles, float particleRadius, float speed, uint32_t seed){
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    const float mass = 30.0f;
+
+    // ball filled to about 30% by volume
+    float ballRadius = particleRadius * std::cbrt(numParticles / 0.3f);
+
+    sim.particles.reserve(sim.particles.size() + numParticles);
+    for(int i = 0; i < numParticles; i++){
+
+        glm::vec3 p;
+        do{
+            p = glm::vec3(unit(gen), unit(gen), unit(gen));
+        } while(glm::dot(p, p) > 1.0f);
+
+        glm::vec3 jitter(unit(gen), unit(gen), unit(gen));
+        sim.addParticle(p * ballRadius, (p + 0.1f * jitter) * speed, mass, particleRadius);
+    }
+}
+
+void addGasScene(Simulation& sim, int numParticles, float particleRadius, float speed, uint32_t seed){
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    const float mass = 30.0f;
+    float extent = sim.params.boundaryRadius - particleRadius;
+
+    sim.particles.reserve(sim.particles.size() + numParticles);
+    for(int i = 0; i < numParticles; i++){
+
+        glm::vec3 p, direction;
+        do{
+            p = glm::vec3(unit(gen), unit(gen), unit(gen));
+        } while(glm::dot(p, p) > 1.0f);
+        do{
+            direction = glm::vec3(unit(gen), unit(gen), unit(gen));
+        } while(glm::dot(direction, direction) > 1.0f || glm::dot(direction, direction) < 1e-4f);
+
+        sim.addParticle(p * extent, glm::normalize(direction) * speed, mass, particleRadius);
+    }
+}
+
+void addStackScene(Simulation& sim, int width, int height, float particleRadius, uint32_t seed){
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    const float mass = 30.0f;
+    float spacing = 2.0f * particleRadius;
+    float offset = 0.5f * (width - 1) * spacing;
+
+    // low enough for the corner columns to rest on the curved boundary
+    float reach = sim.params.boundaryRadius - particleRadius;
+    float bottom = -std::sqrt(std::max(reach * reach - 2.0f * offset * offset, 0.0f));
+
+    sim.particles.reserve(sim.particles.size() + width * width * height);
+    for(int y = 0; y < height; y++){
+        for(int z = 0; z < width; z++){
+            for(int x = 0; x < width; x++){
+                glm::vec3 jitter = 0.01f * particleRadius * glm::vec3(unit(gen), 0.0f, unit(gen));
+                glm::vec3 p(x * spacing - offset, bottom + y * spacing, z * spacing - offset);
+                sim.addParticle(p + jitter, glm::vec3(0.0f), mass, particleRadius);
+            }
+        }
+    }
+}
+
+void addOrbitScene(Simulation& sim, int numParticles, float particleRadius, uint32_t seed){
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    const float mass = 30.0f;
+    glm::vec3 center = sim.params.gravityCenter;
+
+    sim.particles.reserve(sim.particles.size() + numParticles);
+    for(int i = 0; i < numParticles; i++){
+
+        // a random direction and a tangent to it
+        glm::vec3 direction, other;
+        do{
+            direction = glm::vec3(unit(gen), unit(gen), unit(gen));
+            other = glm::vec3(unit(gen), unit(gen), unit(gen));
+        } while(glm::dot(direction, direction) > 1.0f || glm::length(glm::cross(direction, other)) < 1e-3f);
+        direction = glm::normalize(direction);
+        glm::vec3 tangent = glm::normalize(glm::cross(direction, other));
+
+        float distance = 100.0f + 280.0f * uniform(gen);
+        float circular = std::sqrt(sim.params.gConstant / distance);
+        float speed = (0.2f + 0.8f * uniform(gen)) * circular;
+
+        sim.addParticle(center + direction * distance, tangent * speed, mass, particleRadius);
+    }
+}
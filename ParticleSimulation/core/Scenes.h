@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Simulation.h"
+#include <cstdint>
+
+/*
+ * Initial conditions shared by the viewer and the headless runner.
+ */
+
+// The original demo: every particle fired from one point with the same
+// velocity, spawned spawnDelay seconds apart.
+void addFountainScene(Simulation& sim, int numParticles, float spawnDelay);
+
+// Particles scattered uniformly inside the boundary sphere at rest,
+// all present from t = 0. Suited to large batch runs.
+void addCloudScene(Simulation& sim, int numParticles, float particleRadius, uint32_t seed);
+
+// Like the cloud, but radii follow a power law dN/dr ~ r^-3.5 between
+// minRadius and maxRadius (many grains, a few boulders) at equal density.
+void addPolydisperseScene(Simulation& sim, int numParticles, float minRadius, float maxRadius, uint32_t seed);
+
+// A tight ball of particles flying apart at up to `speed`, faster the
+// further out they start. Meant for open domains (params.sphereBoundary
+// off), where the debris spreads far beyond the boundary radius.
+void addExplosionScene(Simulation& sim, int numParticles, float particleRadius, float speed, uint32_t seed);
+
+// A gas: particles scattered uniformly inside the boundary sphere, each
+// moving at `speed` in a random direction. Without gravity
+// (params.gConstant = 0) they fly straight between collisions.
+void addGasScene(Simulation& sim, int numParticles, float particleRadius, float speed, uint32_t seed);
+
+// A block of width x width columns, `height` particles tall, touching in
+// a cubic lattice at rest on the bottom of the boundary sphere (where the
+// default attractor sits), jittered sideways by up to 1% of the radius.
+// The middle columns start slightly above the curved bottom.
+// The lower layers carry the weight of everything above them.
+void addStackScene(Simulation& sim, int width, int height, float particleRadius, uint32_t seed);
+
+// Particles on eccentric orbits about the attractor, at 100 to 380 units
+// from it in random planes, with 20% to 100% of the circular speed, so
+// the pericentres reach down to the attractor. Meant for open domains.
+void addOrbitScene(Simulation& sim, int numParticles, float particleRadius, uint32_t seed);
@@ -0,0 +1,340 @@
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+// MSVC defines no __FMA__, but /arch:AVX2 implies FMA3
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define PARTICLE_AVX2_FMA 1
+#endif
+
+#if defined(__AVX512F__) || defined(PARTICLE_AVX2_FMA)
+#include <immintrin.h>
+#endif
+
+// Scalar version of one lane, also used for the ragged tail of a range
+static inline void verletScalar(ParticleSystem& ps, int i, float dt, float halfDt2, const SimParams& params){
+
+    float px = ps.px[i] + ps.vx[i] * dt + ps.ax[i] * halfDt2;
+    float py = ps.py[i] + ps.vy[i] * dt + ps.ay[i] * halfDt2;
+    float pz = ps.pz[i] + ps.vz[i] * dt + ps.az[i] * halfDt2;
+
+    // a = d / |d| * G / max(|d|, minDistance)^2
+    float dx = params.gravityCenter.x - px;
+    float dy = params.gravityCenter.y - py;
+    float dz = params.gravityCenter.z - pz;
+    float distance = std::sqrt(dx*dx + dy*dy + dz*dz);
+    float clamped = std::max(distance, params.minGravityDistance);
+    float scale = params.gConstant / (distance * clamped * clamped);
+
+    float nax = dx * scale, nay = dy * scale, naz = dz * scale;
+
+    float halfDt = 0.5f * dt;
+    ps.vx[i] += (ps.ax[i] + nax) * halfDt;
+    ps.vy[i] += (ps.ay[i] + nay) * halfDt;
+    ps.vz[i] += (ps.az[i] + naz) * halfDt;
+
+    ps.px[i] = px; ps.py[i] = py; ps.pz[i] = pz;
+    ps.ax[i] = nax; ps.ay[i] = nay; ps.az[i] = naz;
+}
+
+// Scalar gravity sum, also used for the ragged tail of the SIMD paths
+static inline void accumulateGravityScalar(const float* sx, const float* sy, const float* sz, const float* sm, int begin, int end,
+                                           float x, float y, float z, float eps2, float& ax, float& ay, float& az){
+    for(int k = begin; k < end; k++){
+        float dx = sx[k] - x, dy = sy[k] - y, dz = sz[k] - z;
+        float inv = 1.0f / std::sqrt(dx*dx + dy*dy + dz*dz + eps2);
+        float f = sm[k] * inv * inv * inv;
+        ax += dx * f; ay += dy * f; az += dz * f;
+    }
+}
+
+// The 16 pairs' positions and radii, side by side for a vector compare.
+// Plain loads: hardware gathers were slower than this for 16 lanes.
+struct PairLanes{
+    alignas(64) float ax[16], ay[16], az[16], ar[16];
+    alignas(64) float bx[16], by[16], bz[16], br[16];
+
+    PairLanes(const ParticleSystem& ps, const int* first, const int* second){
+        for(int k = 0; k < 16; k++){
+            int a = first[k], b = second[k];
+            ax[k] = ps.px[a]; ay[k] = ps.py[a]; az[k] = ps.pz[a]; ar[k] = ps.radius[a];
+            bx[k] = ps.px[b]; by[k] = ps.py[b]; bz[k] = ps.pz[b]; br[k] = ps.radius[b];
+        }
+    }
+};
+
+#if defined(__AVX512F__)
+
+const char* simdKernelISA(){ return "AVX-512"; }
+int simdKernelWidth(){ return 16; }
+
+void VerletIntegrationRange(ParticleSystem& ps, int begin, int end, float deltaTime, const SimParams& params){
+
+    const float halfDt2 = 0.5f * deltaTime * deltaTime;
+
+    const __m512 dt = _mm512_set1_ps(deltaTime);
+    const __m512 hdt2 = _mm512_set1_ps(halfDt2);
+    const __m512 hdt = _mm512_set1_ps(0.5f * deltaTime);
+    const __m512 cx = _mm512_set1_ps(params.gravityCenter.x);
+    const __m512 cy = _mm512_set1_ps(params.gravityCenter.y);
+    const __m512 cz = _mm512_set1_ps(params.gravityCenter.z);
+    const __m512 g = _mm512_set1_ps(params.gConstant);
+    const __m512 minDistance = _mm512_set1_ps(params.minGravityDistance);
+
+    float *PX = ps.px.data(), *PY = ps.py.data(), *PZ = ps.pz.data();
+    float *VX = ps.vx.data(), *VY = ps.vy.data(), *VZ = ps.vz.data();
+    float *AX = ps.ax.data(), *AY = ps.ay.data(), *AZ = ps.az.data();
+
+    int i = begin;
+    for(; i + 16 <= end; i += 16){
+        __m512 ax = _mm512_loadu_ps(AX + i), ay = _mm512_loadu_ps(AY + i), az = _mm512_loadu_ps(AZ + i);
+        __m512 vx = _mm512_loadu_ps(VX + i), vy = _mm512_loadu_ps(VY + i), vz = _mm512_loadu_ps(VZ + i);
+
+        // drift
+        __m512 px = _mm512_fmadd_ps(ax, hdt2, _mm512_fmadd_ps(vx, dt, _mm512_loadu_ps(PX + i)));
+        __m512 py = _mm512_fmadd_ps(ay, hdt2, _mm512_fmadd_ps(vy, dt, _mm512_loadu_ps(PY + i)));
+        __m512 pz = _mm512_fmadd_ps(az, hdt2, _mm512_fmadd_ps(vz, dt, _mm512_loadu_ps(PZ + i)));
+
+        // central gravity
+        __m512 dx = _mm512_sub_ps(cx, px), dy = _mm512_sub_ps(cy, py), dz = _mm512_sub_ps(cz, pz);
+        __m512 distance = _mm512_sqrt_ps(_mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx))));
+        __m512 clamped = _mm512_max_ps(distance, minDistance);
+        __m512 scale = _mm512_div_ps(g, _mm512_mul_ps(distance, _mm512_mul_ps(clamped, clamped)));
+
+        __m512 nax = _mm512_mul_ps(dx, scale), nay = _mm512_mul_ps(dy, scale), naz = _mm512_mul_ps(dz, scale);
+
+        // kick with the average of old and new acceleration
+        _mm512_storeu_ps(VX + i, _mm512_fmadd_ps(_mm512_add_ps(ax, nax), hdt, vx));
+        _mm512_storeu_ps(VY + i, _mm512_fmadd_ps(_mm512_add_ps(ay, nay), hdt, vy));
+        _mm512_storeu_ps(VZ + i, _mm512_fmadd_ps(_mm512_add_ps(az, naz), hdt, vz));
+
+        _mm512_storeu_ps(PX + i, px); _mm512_storeu_ps(PY + i, py); _mm512_storeu_ps(PZ + i, pz);
+        _mm512_storeu_ps(AX + i, nax); _mm512_storeu_ps(AY + i, nay); _mm512_storeu_ps(AZ + i, naz);
+    }
+
+    for(; i < end; i++){
+        verletScalar(ps, i, deltaTime, halfDt2, params);
+    }
+}
+
+void accumulateGravity(const float* sx, const float* sy, const float* sz, const float* sm, int count,
+                       float x, float y, float z, float eps2, float& ax, float& ay, float& az){
+
+    const __m512 px = _mm512_set1_ps(x), py = _mm512_set1_ps(y), pz = _mm512_set1_ps(z);
+    const __m512 e2 = _mm512_set1_ps(eps2);
+    const __m512 half = _mm512_set1_ps(0.5f), threeHalves = _mm512_set1_ps(1.5f);
+
+    __m512 accX = _mm512_setzero_ps(), accY = _mm512_setzero_ps(), accZ = _mm512_setzero_ps();
+
+    for(int k = 0; k < count; k += 16){
+        // the masked tail loads zero mass, which adds nothing
+        __mmask16 mask = count - k >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (count - k)) - 1);
+
+        __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, sx + k), px);
+        __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, sy + k), py);
+        __m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, sz + k), pz);
+        __m512 m = _mm512_maskz_loadu_ps(mask, sm + k);
+
+        __m512 r2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_fmadd_ps(dx, dx, e2)));
+
+        // 1/sqrt(r2): 14-bit estimate, one Newton-Raphson step
+        __m512 inv = _mm512_rsqrt14_ps(r2);
+        inv = _mm512_mul_ps(inv, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(inv, inv), threeHalves));
+
+        __m512 f = _mm512_mul_ps(m, _mm512_mul_ps(inv, _mm512_mul_ps(inv, inv)));
+        accX = _mm512_fmadd_ps(dx, f, accX);
+        accY = _mm512_fmadd_ps(dy, f, accY);
+        accZ = _mm512_fmadd_ps(dz, f, accZ);
+    }
+
+    ax += _mm512_reduce_add_ps(accX);
+    ay += _mm512_reduce_add_ps(accY);
+    az += _mm512_reduce_add_ps(accZ);
+}
+
+int contactMask16(const ParticleSystem& ps, const int* first, const int* second){
+
+    PairLanes l(ps, first, second);
+
+    __m512 dx = _mm512_sub_ps(_mm512_load_ps(l.ax), _mm512_load_ps(l.bx));
+    __m512 dy = _mm512_sub_ps(_mm512_load_ps(l.ay), _mm512_load_ps(l.by));
+    __m512 dz = _mm512_sub_ps(_mm512_load_ps(l.az), _mm512_load_ps(l.bz));
+    __m512 contact = _mm512_add_ps(_mm512_load_ps(l.ar), _mm512_load_ps(l.br));
+
+    __m512 d2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+    return (int)_mm512_cmp_ps_mask(d2, _mm512_mul_ps(contact, contact), _CMP_LT_OQ);
+}
+
+int sharedLanes16(const int* first, const int* second, int i, int j){
+    __m512i a = _mm512_loadu_si512(first), b = _mm512_loadu_si512(second);
+    __m512i vi = _mm512_set1_epi32(i), vj = _mm512_set1_epi32(j);
+    return (int)(_mm512_cmpeq_epi32_mask(a, vi) | _mm512_cmpeq_epi32_mask(a, vj)
+               | _mm512_cmpeq_epi32_mask(b, vi) | _mm512_cmpeq_epi32_mask(b, vj));
+}
+
+#elif defined(PARTICLE_AVX2_FMA)
+
+const char* simdKernelISA(){ return "AVX2"; }
+int simdKernelWidth(){ return 8; }
+
+void VerletIntegrationRange(ParticleSystem& ps, int begin, int end, float deltaTime, const SimParams& params){
+
+    const float halfDt2 = 0.5f * deltaTime * deltaTime;
+
+    const __m256 dt = _mm256_set1_ps(deltaTime);
+    const __m256 hdt2 = _mm256_set1_ps(halfDt2);
+    const __m256 hdt = _mm256_set1_ps(0.5f * deltaTime);
+    const __m256 cx = _mm256_set1_ps(params.gravityCenter.x);
+    const __m256 cy = _mm256_set1_ps(params.gravityCenter.y);
+    const __m256 cz = _mm256_set1_ps(params.gravityCenter.z);
+    const __m256 g = _mm256_set1_ps(params.gConstant);
+    const __m256 minDistance = _mm256_set1_ps(params.minGravityDistance);
+
+    float *PX = ps.px.data(), *PY = ps.py.data(), *PZ = ps.pz.data();
+    float *VX = ps.vx.data(), *VY = ps.vy.data(), *VZ = ps.vz.data();
+    float *AX = ps.ax.data(), *AY = ps.ay.data(), *AZ = ps.az.data();
+
+    int i = begin;
+    for(; i + 8 <= end; i += 8){
+        __m256 ax = _mm256_loadu_ps(AX + i), ay = _mm256_loadu_ps(AY + i), az = _mm256_loadu_ps(AZ + i);
+        __m256 vx = _mm256_loadu_ps(VX + i), vy = _mm256_loadu_ps(VY + i), vz = _mm256_loadu_ps(VZ + i);
+
+        // drift
+        __m256 px = _mm256_fmadd_ps(ax, hdt2, _mm256_fmadd_ps(vx, dt, _mm256_loadu_ps(PX + i)));
+        __m256 py = _mm256_fmadd_ps(ay, hdt2, _mm256_fmadd_ps(vy, dt, _mm256_loadu_ps(PY + i)));
+        __m256 pz = _mm256_fmadd_ps(az, hdt2, _mm256_fmadd_ps(vz, dt, _mm256_loadu_ps(PZ + i)));
+
+        // central gravity
+        __m256 dx = _mm256_sub_ps(cx, px), dy = _mm256_sub_ps(cy, py), dz = _mm256_sub_ps(cz, pz);
+        __m256 distance = _mm256_sqrt_ps(_mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx))));
+        __m256 clamped = _mm256_max_ps(distance, minDistance);
+        __m256 scale = _mm256_div_ps(g, _mm256_mul_ps(distance, _mm256_mul_ps(clamped, clamped)));
+
+        __m256 nax = _mm256_mul_ps(dx, scale), nay = _mm256_mul_ps(dy, scale), naz = _mm256_mul_ps(dz, scale);
+
+        // kick with the average of old and new acceleration
+        _mm256_storeu_ps(VX + i, _mm256_fmadd_ps(_mm256_add_ps(ax, nax), hdt, vx));
+        _mm256_storeu_ps(VY + i, _mm256_fmadd_ps(_mm256_add_ps(ay, nay), hdt, vy));
+        _mm256_storeu_ps(VZ + i, _mm256_fmadd_ps(_mm256_add_ps(az, naz), hdt, vz));
+
+        _mm256_storeu_ps(PX + i, px); _mm256_storeu_ps(PY + i, py); _mm256_storeu_ps(PZ + i, pz);
+        _mm256_storeu_ps(AX + i, nax); _mm256_storeu_ps(AY + i, nay); _mm256_storeu_ps(AZ + i, naz);
+    }
+
+    for(; i < end; i++){
+        verletScalar(ps, i, deltaTime, halfDt2, params);
+    }
+}
+
+static inline float horizontalSum(__m256 v){
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+void accumulateGravity(const float* sx, const float* sy, const float* sz, const float* sm, int count,
+                       float x, float y, float z, float eps2, float& ax, float& ay, float& az){
+
+    const __m256 px = _mm256_set1_ps(x), py = _mm256_set1_ps(y), pz = _mm256_set1_ps(z);
+    const __m256 e2 = _mm256_set1_ps(eps2);
+    const __m256 half = _mm256_set1_ps(0.5f), threeHalves = _mm256_set1_ps(1.5f);
+
+    __m256 accX = _mm256_setzero_ps(), accY = _mm256_setzero_ps(), accZ = _mm256_setzero_ps();
+
+    int k = 0;
+    for(; k + 8 <= count; k += 8){
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(sx + k), px);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(sy + k), py);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(sz + k), pz);
+        __m256 m = _mm256_loadu_ps(sm + k);
+
+        __m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_fmadd_ps(dx, dx, e2)));
+
+        // 1/sqrt(r2): 12-bit estimate, one Newton-Raphson step
+        __m256 inv = _mm256_rsqrt_ps(r2);
+        inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(inv, inv), threeHalves));
+
+        __m256 f = _mm256_mul_ps(m, _mm256_mul_ps(inv, _mm256_mul_ps(inv, inv)));
+        accX = _mm256_fmadd_ps(dx, f, accX);
+        accY = _mm256_fmadd_ps(dy, f, accY);
+        accZ = _mm256_fmadd_ps(dz, f, accZ);
+    }
+
+    ax += horizontalSum(accX);
+    ay += horizontalSum(accY);
+    az += horizontalSum(accZ);
+
+    accumulateGravityScalar(sx, sy, sz, sm, k, count, x, y, z, eps2, ax, ay, az);
+}
+
+int contactMask16(const ParticleSystem& ps, const int* first, const int* second){
+
+    PairLanes l(ps, first, second);
+
+    int mask = 0;
+    for(int half = 0; half < 16; half += 8){
+        __m256 dx = _mm256_sub_ps(_mm256_load_ps(l.ax + half), _mm256_load_ps(l.bx + half));
+        __m256 dy = _mm256_sub_ps(_mm256_load_ps(l.ay + half), _mm256_load_ps(l.by + half));
+        __m256 dz = _mm256_sub_ps(_mm256_load_ps(l.az + half), _mm256_load_ps(l.bz + half));
+        __m256 contact = _mm256_add_ps(_mm256_load_ps(l.ar + half), _mm256_load_ps(l.br + half));
+
+        __m256 d2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+        mask |= _mm256_movemask_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(contact, contact), _CMP_LT_OQ)) << half;
+    }
+    return mask;
+}
+
+int sharedLanes16(const int* first, const int* second, int i, int j){
+    __m256i vi = _mm256_set1_epi32(i), vj = _mm256_set1_epi32(j);
+
+    int mask = 0;
+    for(int half = 0; half < 16; half += 8){
+        __m256i a = _mm256_loadu_si256((const __m256i*)(first + half));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(second + half));
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi32(a, vi), _mm256_cmpeq_epi32(a, vj)),
+                                      _mm256_or_si256(_mm256_cmpeq_epi32(b, vi), _mm256_cmpeq_epi32(b, vj)));
+        mask |= _mm256_movemask_ps(_mm256_castsi256_ps(hit)) << half;
+    }
+    return mask;
+}
+
+#else
+
+const char* simdKernelISA(){ return "scalar"; }
+int simdKernelWidth(){ return 1; }
+
+void VerletIntegrationRange(ParticleSystem& ps, int begin, int end, float deltaTime, const SimParams& params){
+    const float halfDt2 = 0.5f * deltaTime * deltaTime;
+    for(int i = begin; i < end; i++){
+        verletScalar(ps, i, deltaTime, halfDt2, params);
+    }
+}
+
+void accumulateGravity(const float* sx, const float* sy, const float* sz, const float* sm, int count,
+                       float x, float y, float z, float eps2, float& ax, float& ay, float& az){
+    accumulateGravityScalar(sx, sy, sz, sm, 0, count, x, y, z, eps2, ax, ay, az);
+}
+
+int contactMask16(const ParticleSystem& ps, const int* first, const int* second){
+    int mask = 0;
+    for(int k = 0; k < 16; k++){
+        int a = first[k], b = second[k];
+        float dx = ps.px[a] - ps.px[b], dy = ps.py[a] - ps.py[b], dz = ps.pz[a] - ps.pz[b];
+        float contact = ps.radius[a] + ps.radius[b];
+        mask |= dx*dx + dy*dy + dz*dz < contact * contact ? 1 << k : 0;
+    }
+    return mask;
+}
+
+int sharedLanes16(const int* first, const int* second, int i, int j){
+    int mask = 0;
+    for(int k = 0; k < 16; k++){
+        bool shared = first[k] == i || first[k] == j || second[k] == i || second[k] == j;
+        mask |= shared ? 1 << k : 0;
+    }
+    return mask;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ParticleSystem.h"
+
+/*
+ * Vectorised particle kernels over contiguous SoA ranges.
+ *
+ * The kernels do the whole velocity Verlet step (drift, central gravity,
+ * velocity kick) for 16 particles per instruction with AVX-512, 8 with
+ * AVX2+FMA, or one at a time in the scalar fallback. Which one is built
+ * depends on the compiler flags, see PARTICLE_NATIVE_ARCH in CMakeLists.
+ * Results match VerletIntegration()/SetGravity() to float rounding.
+ */
+
+// Instruction set the kernels were compiled for ("AVX-512", "AVX2", "scalar")
+const char* simdKernelISA();
+
+// Particles processed per instruction
+int simdKernelWidth();
+
+// VerletIntegration() + SetGravity() for the particles [begin, end)
+void VerletIntegrationRange(ParticleSystem& ps, int begin, int end, float deltaTime, const SimParams& params);
+
+// Add the softened gravity of `count` sources (SoA positions and masses) at
+// the point (x, y, z) to ax/ay/az, without the factor G:
+//   a += m r / (r^2 + eps2)^(3/2)
+// eps2 must be positive, so a source sitting on the point adds nothing.
+// The SIMD paths use a reciprocal square root estimate refined by one
+// Newton-Raphson step.
+void accumulateGravity(const float* sx, const float* sy, const float* sz, const float* sm, int count,
+                       float x, float y, float z, float eps2, float& ax, float& ay, float& az);
+
+// Overlap test for 16 candidate pairs at once: bit k of the result is set
+// when |p_a - p_b|^2 < (r_a + r_b)^2 for a = first[k], b = second[k].
+// No square root is taken.
+int contactMask16(const ParticleSystem& ps, const int* first, const int* second);
+
+// Bit k is set when pair k (first[k], second[k]) involves particle i or j
+int sharedLanes16(const int* first, const int* second, int i, int j);
@@ -0,0 +1,780 @@
+#include "Simulation.h"
+#include "KeplerDrift.h"
+#include "Morton.h"
+#include "ParticlePhysics.h"
+#include "SimdKernels.h"
+#include "SplittingIntegrators.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// particles per parallel-for chunk in the per-particle passes
+static const int particleGrain = 1024;
+
+// grid blocks per parallel-for chunk in the collision pass
+static const int blockGrain = 8;
+
+Simulation::Simulation(){
+    pool = std::make_unique<ThreadPool>(1);
+}
+
+void Simulation::setThreadCount(int numThreads){
+    pool = std::make_unique<ThreadPool>(numThreads);
+}
+
+int Simulation::addParticle(glm::vec3 pos, glm::vec3 vel, float m, float r, float spawnTime){
+    spawnTimes.push_back(spawnTime);
+    return particles.add(pos, vel, m, r);
+}
+
+void Simulation::reorderParticles(){
+    int n = (int)particles.size();
+    if (n == 0){
+        return;
+    }
+
+    // bounding box of the spawned particles
+    glm::vec3 lo(0.0f), hi(0.0f);
+    bool any = false;
+    for(int i = 0; i < n; i++){
+        if (elapsedTime >= spawnTimes[i]){
+            glm::vec3 p = particles.position(i);
+            lo = any ? glm::min(lo, p) : p;
+            hi = any ? glm::max(hi, p) : p;
+            any = true;
+        }
+    }
+    glm::vec3 extent = glm::max(hi - lo, glm::vec3(1e-3f)) * 1.0001f;
+    glm::vec3 toGrid = glm::vec3((float)mortonMaxCoord) / extent;
+
+    // spawned particles by Morton key, then the rest in their current order
+    const uint64_t unspawned = 1ull << 63;
+    reorderKeys.resize(n);
+    reorderOrder.resize(n);
+    pool->parallelFor(0, n, particleGrain, [&](int begin, int end){
+        for(int i = begin; i < end; i++){
+            if (elapsedTime >= spawnTimes[i]){
+                uint32_t x = (uint32_t)std::max((particles.px[i] - lo.x) * toGrid.x, 0.0f);
+                uint32_t y = (uint32_t)std::max((particles.py[i] - lo.y) * toGrid.y, 0.0f);
+                uint32_t z = (uint32_t)std::max((particles.pz[i] - lo.z) * toGrid.z, 0.0f);
+                reorderKeys[i] = mortonEncode(std::min(x, mortonMaxCoord), std::min(y, mortonMaxCoord), std::min(z, mortonMaxCoord));
+            }
+            else{
+                reorderKeys[i] = unspawned | (uint64_t)i;
+            }
+            reorderOrder[i] = i;
+        }
+    });
+    sorter.sort(reorderKeys, reorderOrder, 64, *pool);
+
+    // gather every column into the new order
+    columnScratch.resize(n);
+    for(AlignedVector<float>* column : particles.columns()){
+        pool->parallelFor(0, n, particleGrain, [&](int begin, int end){
+            for(int k = begin; k < end; k++){
+                columnScratch[k] = (*column)[reorderOrder[k]];
+            }
+        });
+        column->swap(columnScratch);
+    }
+
+    // spawn times and ids move with the particles
+    idScratch.resize(n);
+    spawnScratch.resize(n);
+    for(int k = 0; k < n; k++){
+        idScratch[k] = particles.id[reorderOrder[k]];
+        spawnScratch[k] = spawnTimes[reorderOrder[k]];
+    }
+    particles.id.swap(idScratch);
+    spawnTimes.swap(spawnScratch);
+    for(int k = 0; k < n; k++){
+        particles.idToIndex[particles.id[k]] = k;
+    }
+
+    // and so does the integrators' double state, or it would be dropped
+    if (!doublePosition.empty()){
+        resizeDoubleState();
+        for(std::vector<glm::dvec3>* state : { &doublePosition, &doubleVelocity }){
+            doubleScratch.resize(n);
+            for(int k = 0; k < n; k++){
+                doubleScratch[k] = (*state)[reorderOrder[k]];
+            }
+            state->swap(doubleScratch);
+        }
+    }
+
+    // lists, cells and islands refer to particles by index
+    sleepIslands.permute(reorderOrder);
+    neighbourList.invalidate();
+    incrementalGrid.invalidate();
+}
+
+// Run loop(visit) over a chunk of candidate pairs: batched through the
+// SIMD narrowphase, or each pair straight into Particle3DCollision
+template <typename PairLoop>
+static void resolveCandidates(ParticleSystem& ps, const SimParams& params, ContactBatch& batch, bool batched, PairLoop loop){
+    if (batched){
+        loop([&](int i, int j){ batch.add(ps, params, i, j); });
+        batch.flush(ps, params);
+    }
+    else{
+        loop([&](int i, int j){
+            batch.candidates++;
+            if (Particle3DCollision(ps, i, j, params)){
+                batch.touched(i, j);
+            }
+        });
+    }
+}
+
+void Simulation::collideParticles(float deltaTime){
+    if (contactResponse == ContactResponse::XPBD){
+        contactSolver.begin(pool->size());
+        resolveCandidatePairs();
+        contactSolver.solve(particles, awakeParticles, deltaTime, *pool);
+
+        lastCandidates = contactSolver.lastCandidates;
+        lastContacts = contactSolver.contactCount();
+        lastBatched = false;
+        return;
+    }
+
+    lastBatched = batchedNarrowphase && lastContacts <= batchedMaxContactRatio * lastCandidates;
+
+    contactBatches.resize(pool->size());
+    for(ContactBatch& batch : contactBatches){
+        batch.candidates = 0;
+        batch.contacts = 0;
+        batch.recordPairs = sleepingActive;
+        batch.pairs.clear();
+    }
+
+    resolveCandidatePairs();
+
+    lastCandidates = 0;
+    lastContacts = 0;
+    for(const ContactBatch& batch : contactBatches){
+        lastCandidates += batch.candidates;
+        lastContacts += batch.contacts;
+    }
+}
+
+void Simulation::resolveCandidatePairs(){
+
+    // resolve(thread, loop): loop(visit) visits a chunk of blocks' candidate
+    // pairs, which go through the thread's narrowphase batch (or straight
+    // to the response) and are all settled before resolve returns. The
+    // XPBD response only collects them for the contact solver.
+    auto resolve = [&](int thread, auto loop){
+        if (contactResponse == ContactResponse::XPBD){
+            loop([&](int i, int j){ contactSolver.addCandidate(particles, thread, i, j); });
+        }
+        else{
+            resolveCandidates(particles, params, contactBatches[thread], lastBatched, loop);
+        }
+    };
+
+    if (collisionMode == CollisionMode::AllPairs){
+
+        // Detect collision for iteration i against every later iteration j
+        resolve(0, [&](auto visit){
+            for(size_t a = 0; a < awakeParticles.size(); a++){
+                for(size_t b = a+1; b < awakeParticles.size(); b++){
+                    visit(awakeParticles[a], awakeParticles[b]);
+                }
+            }
+        });
+        return;
+    }
+
+    if (collisionMode == CollisionMode::SweepAndPrune){
+        sweepAndPrune.update(particles, awakeParticles, *pool);
+
+        // detection is parallel, the response runs in sweep order like AllPairs
+        const std::vector<int>& pairs = sweepAndPrune.pairs();
+        resolve(0, [&](auto visit){
+            for(size_t p = 0; p < pairs.size(); p += 2){
+                visit(pairs[p], pairs[p + 1]);
+            }
+        });
+        return;
+    }
+
+    if (collisionMode == CollisionMode::NeighbourList){
+        neighbourList.update(particles, awakeParticles, *pool);
+
+        // batches are the grid's colour blocks, so this is lock-free too
+        for(int colour = 0; colour < NeighbourList::numColours; colour++){
+            pool->parallelForThreads(0, neighbourList.colourBatchCount(colour), blockGrain, [&](int begin, int end, int thread){
+                resolve(thread, [&](auto visit){
+                    for(int k = begin; k < end; k++){
+                        neighbourList.forEachPairInColourBatch(colour, k, visit);
+                    }
+                });
+            });
+        }
+        return;
+    }
+
+    if (collisionMode == CollisionMode::HashGrid){
+        hashGrid.build(particles, awakeParticles, *pool);
+
+        for(int colour = 0; colour < HashGrid::numColours; colour++){
+            pool->parallelForThreads(0, hashGrid.colourBatchCount(colour), blockGrain, [&](int begin, int end, int thread){
+                resolve(thread, [&](auto visit){
+                    for(int k = begin; k < end; k++){
+                        hashGrid.forEachPairInColourBatch(colour, k, visit);
+                    }
+                });
+            });
+        }
+        return;
+    }
+
+    if (collisionMode == CollisionMode::IncrementalGrid){
+        incrementalGrid.update(particles, awakeParticles, *pool);
+
+        for(int colour = 0; colour < SpatialGrid::numColours; colour++){
+            pool->parallelForThreads(0, incrementalGrid.colourBlockCount(colour), blockGrain, [&](int begin, int end, int thread){
+                resolve(thread, [&](auto visit){
+                    for(int k = begin; k < end; k++){
+                        incrementalGrid.forEachPairInColourBlock(colour, k, visit);
+                    }
+                });
+            });
+        }
+        return;
+    }
+
+    if (collisionMode == CollisionMode::HierarchicalGrid){
+        hierarchicalGrid.build(particles, awakeParticles, *pool);
+
+        // each level on its own grid, then the cross-level pairs, both
+        // scheduled by colour blocks
+        for(int level = 0; level < hierarchicalGrid.levelCount; level++){
+            const SpatialGrid& levelGrid = hierarchicalGrid.levels[level].grid;
+            for(int colour = 0; colour < SpatialGrid::numColours; colour++){
+                pool->parallelForThreads(0, levelGrid.colourBlockCount(colour), blockGrain, [&](int begin, int end, int thread){
+                    resolve(thread, [&](auto visit){
+                        for(int k = begin; k < end; k++){
+                            levelGrid.forEachPairInColourBlock(colour, k, visit);
+                        }
+                    });
+                });
+            }
+        }
+        for(int level = 1; level < hierarchicalGrid.levelCount; level++){
+            for(int colour = 0; colour < SpatialGrid::numColours; colour++){
+                pool->parallelForThreads(0, hierarchicalGrid.crossBatchCount(level, colour), blockGrain, [&](int begin, int end, int thread){
+                    resolve(thread, [&](auto visit){
+                        for(int k = begin; k < end; k++){
+                            hierarchicalGrid.forEachCrossPairInBatch(level, colour, k, visit);
+                        }
+                    });
+                });
+            }
+        }
+        return;
+    }
+
+    float maxRadius = 0.0f;
+    for(int i : awakeParticles){
+        maxRadius = std::max(maxRadius, particles.radius[i]);
+    }
+
+    grid.build(awakeParticles, [&](int i){ return particles.position(i); }, maxRadius);
+
+    // Same-coloured blocks never share a particle, so each colour is
+    // resolved in parallel without locks and the result is independent
+    // of the thread count.
+    for(int colour = 0; colour < SpatialGrid::numColours; colour++){
+        pool->parallelForThreads(0, grid.colourBlockCount(colour), blockGrain, [&](int begin, int end, int thread){
+            resolve(thread, [&](auto visit){
+                for(int k = begin; k < end; k++){
+                    grid.forEachPairInColourBlock(colour, k, visit);
+                }
+            });
+        });
+    }
+}
+
+void Simulation::step(float deltaTime){
+
+    if (reorderInterval > 0 && ++stepsSinceReorder >= reorderInterval){
+        reorderParticles();
+        stepsSinceReorder = 0;
+    }
+
+    elapsedTime += deltaTime;
+
+    // elapsedTime is for the time delay in spawning each particle
+    activeParticles.clear();
+    for(int i = 0; i < (int)particles.size(); i++){
+        if(elapsedTime >= spawnTimes[i]){
+            activeParticles.push_back(i);
+        }
+    }
+
+    // under mutual gravity a sleeping particle would still pull on the rest
+    sleepingActive = allowSleeping && !eventDriven && gravityMode == GravityMode::CentralAttractor;
+    sleepIslands.resize((int)particles.size());
+    if (!sleepingActive && sleepIslands.sleepingCount() > 0){
+        sleepIslands.wakeAll();
+        awakeSetChanged();
+    }
+    collectAwakeParticles();
+
+    if (eventDriven){
+        // anything else may have moved the particles since its last step
+        if (!hardSpheresCurrent){
+            hardSpheres.invalidate();
+        }
+        hardSpheres.advance(particles, activeParticles, params, deltaTime);
+        hardSpheresCurrent = true;
+        forceCount = -1;
+        return;
+    }
+    hardSpheresCurrent = false;
+
+    // sleepers keep still, so their start is where they are if they wake
+    if (continuousCollisions){
+        sweptCollisions.begin(particles, activeParticles, *pool);
+    }
+
+    if (gravityMode == GravityMode::CentralAttractor){
+        integrateCentral(deltaTime);
+    }
+    else{
+        integrateMutual(deltaTime);
+    }
+
+    // islands touched by a moving particle join the rest of the step
+    if (sleepingActive && sleepIslands.wakeTouched(particles, awakeParticles, deltaTime, *pool)){
+        collectAwakeParticles();
+        awakeSetChanged();
+    }
+
+    if (continuousCollisions){
+        sweptCollisions.resolvePairs(particles, awakeParticles, params, deltaTime, *pool);
+    }
+
+    collideParticles(deltaTime);
+
+    // Boundary Sphere collision
+    if (params.sphereBoundary){
+        int numAwake = (int)awakeParticles.size();
+        pool->parallelFor(0, numAwake, particleGrain, [&](int begin, int end){
+            for(int k = begin; k < end; k++){
+                int i = awakeParticles[k];
+                if (continuousCollisions){
+                    float remaining = (1.0f - sweptCollisions.pathStartTime(i)) * deltaTime;
+                    checkSweptSphereCollision(particles, i, sweptCollisions.pathStart(i), remaining, params);
+                }
+                else{
+                    checkSphereCollision(particles, i, params);
+                }
+            }
+        });
+    }
+
+    if (sleepingActive){
+        sleepIslands.beginIslands(awakeParticles);
+        if (contactResponse == ContactResponse::XPBD){
+            contactSolver.forEachTouching([&](int i, int j){ sleepIslands.link(i, j); });
+        }
+        else{
+            for(const ContactBatch& batch : contactBatches){
+                for(size_t p = 0; p < batch.pairs.size(); p += 2){
+                    sleepIslands.link(batch.pairs[p], batch.pairs[p + 1]);
+                }
+            }
+        }
+        if (sleepIslands.endIslands(particles, awakeParticles, params, deltaTime)){
+            awakeSetChanged();
+        }
+    }
+}
+
+void Simulation::collectAwakeParticles(){
+    if (!sleepingActive || sleepIslands.sleepingCount() == 0){
+        awakeParticles = activeParticles;
+        return;
+    }
+
+    awakeParticles.clear();
+    for(int i : activeParticles){
+        if (!sleepIslands.isSleeping(i)){
+            awakeParticles.push_back(i);
+        }
+    }
+}
+
+void Simulation::awakeSetChanged(){
+    // the persistent broadphases hold on to the particles they were given
+    neighbourList.invalidate();
+    incrementalGrid.invalidate();
+    sweepAndPrune.invalidate();
+}
+
+void Simulation::integrateCentral(float deltaTime){
+    // the splitting schemes that open with a kick need the attractor's
+    // accelerations, not a particle's starting ones
+    bool kickFirst = integrator != Integrator::Verlet && integrator != Integrator::WisdomHolman;
+    if (kickFirst && (forceMode != GravityMode::CentralAttractor || forceCount != (int)activeParticles.size())){
+        computeCentralAccelerations();
+    }
+
+    if (maxTimestepLevel > 0){
+        integrateBlocks(deltaTime);
+    }
+    else{
+        integrateList(awakeParticles.data(), (int)awakeParticles.size(), deltaTime);
+        levelCounts.assign(1, (int)awakeParticles.size());
+        lastUpdatesPerParticle = 1.0;
+        lastTimeMismatch = 0.0;
+    }
+
+    forceMode = GravityMode::CentralAttractor;
+    forceCount = (int)activeParticles.size();
+}
+
+void Simulation::computeCentralAccelerations(){
+    int numActive = (int)activeParticles.size();
+    pool->parallelFor(0, numActive, particleGrain, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            int i = activeParticles[k];
+            particles.setAcceleration(i, glm::vec3(0.0f));
+            SetGravity(particles, i, params);
+        }
+    });
+}
+
+void Simulation::resizeDoubleState(){
+    doublePosition.resize(particles.size(), glm::dvec3(std::numeric_limits<double>::quiet_NaN()));
+    doubleVelocity.resize(particles.size());
+}
+
+void Simulation::loadDoubleState(int i, glm::dvec3& p, glm::dvec3& v) const {
+    // carry on from the double state unless something else moved the particle
+    p = doublePosition[i];
+    v = doubleVelocity[i];
+    if (glm::vec3(p) != particles.position(i) || glm::vec3(v) != particles.velocity(i)){
+        p = glm::dvec3(particles.position(i));
+        v = glm::dvec3(particles.velocity(i));
+    }
+}
+
+void Simulation::storeDoubleState(int i, glm::dvec3 p, glm::dvec3 v){
+    doublePosition[i] = p;
+    doubleVelocity[i] = v;
+    particles.setPosition(i, glm::vec3(p));
+    particles.setVelocity(i, glm::vec3(v));
+}
+
+void Simulation::driftKepler(const int* indices, int count, float deltaTime){
+    glm::dvec3 center = glm::dvec3(params.gravityCenter);
+    resizeDoubleState();
+
+    pool->parallelFor(0, count, particleGrain, [&](int begin, int end){
+        // relative to the attractor, a block at a time
+        const int block = 256;
+        double x[block], y[block], z[block], vx[block], vy[block], vz[block];
+
+        for(int first = begin; first < end; first += block){
+            int n = std::min(block, end - first);
+            for(int k = 0; k < n; k++){
+                glm::dvec3 p, v;
+                loadDoubleState(indices[first + k], p, v);
+                p -= center;
+                x[k] = p.x; y[k] = p.y; z[k] = p.z;
+                vx[k] = v.x; vy[k] = v.y; vz[k] = v.z;
+            }
+
+            keplerDrift(x, y, z, vx, vy, vz, n, params.gConstant, deltaTime);
+
+            for(int k = 0; k < n; k++){
+                storeDoubleState(indices[first + k], center + glm::dvec3(x[k], y[k], z[k]), glm::dvec3(vx[k], vy[k], vz[k]));
+            }
+        }
+    });
+}
+
+template <typename Scheme>
+void Simulation::integrateSplitting(const int* indices, int count, float deltaTime){
+    glm::dvec3 center = glm::dvec3(params.gravityCenter);
+    double g = params.gConstant;
+    double minDistance = params.minGravityDistance;
+
+    // SetGravity in double
+    auto accel = [=](glm::dvec3 p){
+        glm::dvec3 direction = center - p;
+        double distance = glm::length(direction);
+        direction /= distance;
+        distance = std::max(distance, minDistance);
+        return direction * (g / (distance * distance));
+    };
+
+    resizeDoubleState();
+    pool->parallelFor(0, count, particleGrain, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            int i = indices[k];
+            glm::dvec3 p, v;
+            loadDoubleState(i, p, v);
+            glm::dvec3 a = glm::dvec3(particles.acceleration(i));
+
+            splittingStep<Scheme>(p, v, a, deltaTime, accel);
+
+            storeDoubleState(i, p, v);
+            particles.setAcceleration(i, glm::vec3(a));
+        }
+    });
+}
+
+void Simulation::integrateList(const int* indices, int count, float deltaTime){
+    switch(integrator){
+        case Integrator::Leapfrog:
+            integrateSplitting<Leapfrog>(indices, count, deltaTime);
+            return;
+        case Integrator::ForestRuth:
+            integrateSplitting<ForestRuth>(indices, count, deltaTime);
+            return;
+        case Integrator::Yoshida4:
+            integrateSplitting<Yoshida4>(indices, count, deltaTime);
+            return;
+        case Integrator::Yoshida6:
+            integrateSplitting<Yoshida6>(indices, count, deltaTime);
+            return;
+        case Integrator::Omelyan:
+            integrateSplitting<Omelyan>(indices, count, deltaTime);
+            return;
+        case Integrator::WisdomHolman:
+            // the attractor's own force is all in the drift; ax/ay/az
+            // still hold it for the timestep levels and sleeping
+            driftKepler(indices, count, deltaTime);
+            pool->parallelFor(0, count, particleGrain, [&](int begin, int end){
+                for(int k = begin; k < end; k++){
+                    particles.setAcceleration(indices[k], glm::vec3(0.0f));
+                    SetGravity(particles, indices[k], params);
+                }
+            });
+            return;
+        case Integrator::Verlet:
+            break;
+    }
+
+    if (useSimdKernels){
+        // runs of consecutive indices go through the vector kernel; spawn
+        // times are usually increasing and sleepers cluster after a Morton
+        // reorder, so the runs are long (the whole list when all are awake).
+        // They are cut at every particleGrain-th particle index rather than
+        // wherever the pool's chunks end, so which particles take the
+        // kernel's scalar tail does not depend on the thread count.
+        integrationRuns.clear();
+        for(int k = 0; k < count; k++){
+            if (k == 0 || indices[k] != indices[k - 1] + 1 || indices[k] % particleGrain == 0){
+                integrationRuns.push_back(k);
+            }
+        }
+        integrationRuns.push_back(count);
+
+        pool->parallelFor(0, (int)integrationRuns.size() - 1, 1, [&](int begin, int end){
+            for(int r = begin; r < end; r++){
+                int first = integrationRuns[r], last = integrationRuns[r + 1];
+                VerletIntegrationRange(particles, indices[first], indices[last - 1] + 1, deltaTime, params);
+            }
+        });
+    }
+    else{
+        pool->parallelFor(0, count, particleGrain, [&](int begin, int end){
+            for(int k = begin; k < end; k++){
+                VerletIntegration(particles, indices[k], deltaTime, params);
+            }
+        });
+    }
+}
+
+int Simulation::timestepLevel(int i, float deltaTime) const {
+    float distance = std::max(glm::length(particles.position(i) - params.gravityCenter), params.minGravityDistance);
+    float accel = glm::length(particles.acceleration(i));
+    float speed = glm::length(particles.velocity(i));
+
+    // at rest, or before the first step, the other limit decides
+    float limit = std::numeric_limits<float>::max();
+    if (accel > 0.0f) limit = std::min(limit, std::sqrt(distance / accel));
+    if (speed > 0.0f) limit = std::min(limit, distance / speed);
+    limit *= timestepAccuracy;
+
+    int level = 0;
+    while(level < maxTimestepLevel && deltaTime / (float)(1 << level) > limit){
+        level++;
+    }
+    return level;
+}
+
+void Simulation::integrateBlocks(float deltaTime){
+    int numAwake = (int)awakeParticles.size();
+    particleLevel.resize(particles.size());
+    stepTime.resize(particles.size());
+    levelLists.resize(maxTimestepLevel + 1);
+    heldLists.resize(maxTimestepLevel + 1);
+
+    // every particle is synchronised at the start of a step, so any level will do
+    pool->parallelFor(0, numAwake, particleGrain, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            int i = awakeParticles[k];
+            particleLevel[i] = (uint8_t)timestepLevel(i, deltaTime);
+            stepTime[i] = 0.0;
+        }
+    });
+    for(int level = 0; level <= maxTimestepLevel; level++){
+        levelLists[level].clear();
+        heldLists[level].clear();
+    }
+    for(int i : awakeParticles){
+        levelLists[particleLevel[i]].push_back(i);
+    }
+
+    // Level L is due on every 2^(max - L)th substep. The attractor is the
+    // only force, so the levels need no synchronising with each other.
+    // After its step a particle may move to a finer level, but it is then
+    // 2^(max - L) substeps ahead of the start of this one: it waits in
+    // heldLists[L] until L is next due, which the finer level is as well,
+    // and joins the finer list from there.
+    long long updates = 0;
+    int numSubsteps = 1 << maxTimestepLevel;
+    for(int substep = 0; substep < numSubsteps; substep++){
+        for(int level = 0; level < maxTimestepLevel; level++){
+            if (substep % (1 << (maxTimestepLevel - level)) != 0){
+                continue;
+            }
+            for(int i : heldLists[level]){
+                levelLists[particleLevel[i]].push_back(i);
+            }
+            heldLists[level].clear();
+        }
+
+        for(int level = maxTimestepLevel; level >= 0; level--){
+            std::vector<int>& list = levelLists[level];
+            if (list.empty() || substep % (1 << (maxTimestepLevel - level)) != 0){
+                continue;
+            }
+            float levelDt = deltaTime / (float)(1 << level);
+            integrateList(list.data(), (int)list.size(), levelDt);
+            updates += (long long)list.size();
+
+            int count = (int)list.size();
+            bool refine = level < maxTimestepLevel;
+            pool->parallelFor(0, count, particleGrain, [&](int begin, int end){
+                for(int k = begin; k < end; k++){
+                    int i = list[k];
+                    stepTime[i] += levelDt;
+                    if (refine){
+                        particleLevel[i] = (uint8_t)std::max(timestepLevel(i, deltaTime), level);
+                    }
+                }
+            });
+            if (!refine){
+                continue;
+            }
+            int kept = 0;
+            for(int k = 0; k < count; k++){
+                int i = list[k];
+                if (particleLevel[i] == level){
+                    list[kept++] = i;
+                }
+                else{
+                    heldLists[level].push_back(i);
+                }
+            }
+            list.resize(kept);
+        }
+    }
+
+    // those refined on their last substep are held, but already at the end
+    lastTimeMismatch = 0.0;
+    for(int i : awakeParticles){
+        lastTimeMismatch = std::max(lastTimeMismatch, std::abs(stepTime[i] - (double)deltaTime));
+    }
+
+    levelCounts.assign(maxTimestepLevel + 1, 0);
+    for(int i : awakeParticles){
+        levelCounts[particleLevel[i]]++;
+    }
+    lastUpdatesPerParticle = numAwake > 0 ? (double)updates / numAwake : 1.0;
+}
+
+void Simulation::computeMutualAccelerations(){
+    switch(gravityMode){
+        case GravityMode::BarnesHut:
+            barnesHut.computeAccelerations(particles, activeParticles, params.mutualG, params.softeningLength, *pool);
+            break;
+        case GravityMode::DirectSum:
+            directSum.computeAccelerations(particles, activeParticles, params.mutualG, params.softeningLength, *pool);
+            break;
+        case GravityMode::ParticleMesh:
+            particleMesh.computeAccelerations(particles, activeParticles, params.mutualG, params.softeningLength, *pool);
+            break;
+        case GravityMode::FastMultipole:
+            fastMultipole.computeAccelerations(particles, activeParticles, params.mutualG, params.softeningLength, *pool);
+            break;
+        case GravityMode::CentralAttractor:
+            break;
+    }
+
+    forceMode = gravityMode;
+    forceCount = (int)activeParticles.size();
+}
+
+void Simulation::integrateMutual(float deltaTime){
+    int numActive = (int)activeParticles.size();
+    float halfDt = 0.5f * deltaTime;
+
+    // the first kick needs this mode's accelerations for this particle set
+    if (forceMode != gravityMode || forceCount != numActive){
+        computeMutualAccelerations();
+    }
+
+    // kick-drift-kick, the same update as VerletIntegration; Wisdom-Holman
+    // drifts along the Kepler orbits about the attractor instead
+    bool kepler = integrator == Integrator::WisdomHolman;
+    pool->parallelFor(0, numActive, particleGrain, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            int i = activeParticles[k];
+            particles.vx[i] += particles.ax[i] * halfDt;
+            particles.vy[i] += particles.ay[i] * halfDt;
+            particles.vz[i] += particles.az[i] * halfDt;
+            if (!kepler){
+                particles.px[i] += particles.vx[i] * deltaTime;
+                particles.py[i] += particles.vy[i] * deltaTime;
+                particles.pz[i] += particles.vz[i] * deltaTime;
+            }
+        }
+    });
+
+    if (kepler){
+        driftKepler(activeParticles.data(), numActive, deltaTime);
+    }
+
+    computeMutualAccelerations();
+
+    pool->parallelFor(0, numActive, particleGrain, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            int i = activeParticles[k];
+            particles.vx[i] += particles.ax[i] * halfDt;
+            particles.vy[i] += particles.ay[i] * halfDt;
+            particles.vz[i] += particles.az[i] * halfDt;
+        }
+    });
+}
+
+double Simulation::kineticEnergy() const {
+    double energy = 0.0;
+    for(int i : activeParticles){
+        double v2 = (double)particles.vx[i] * particles.vx[i]
+                  + (double)particles.vy[i] * particles.vy[i]
+                  + (double)particles.vz[i] * particles.vz[i];
+        energy += 0.5 * particles.mass[i] * v2;
+    }
+    return energy;
+}
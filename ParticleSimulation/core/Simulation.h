@@ -0,0 +1,248 @@
+#pragma once
+
+#include "BarnesHut.h"
+#include "ContactSolver.h"
+#include "DirectGravity.h"
+#include "FastMultipole.h"
+#include "HardSpheres.h"
+#include "HashGrid.h"
+#include "HierarchicalGrid.h"
+#include "IncrementalGrid.h"
+#include "Narrowphase.h"
+#include "NeighbourList.h"
+#include "ParticleMesh.h"
+#include "ParticleSystem.h"
+#include "RadixSort.h"
+#include "SleepIslands.h"
+#include "SpatialGrid.h"
+#include "SweepAndPrune.h"
+#include "SweptCollisions.h"
+#include "ThreadPool.h"
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+/*
+ * Simulation state and stepping, independent of any window or GL context.
+ *
+ * The viewer and the headless runner both own a Simulation, call step()
+ * and then read particles/activeParticles back for drawing or statistics.
+ */
+
+// Collision broadphase, AllPairs is the O(N^2) reference loop.
+// NeighbourList keeps Verlet lists across steps (see NeighbourList.h),
+// SweepAndPrune sorts intervals along one axis (see SweepAndPrune.h),
+// HierarchicalGrid bins each size class separately (see HierarchicalGrid.h),
+// IncrementalGrid only re-bins particles that changed cell (see IncrementalGrid.h),
+// HashGrid stores occupied cells only and needs no bounds (see HashGrid.h).
+enum class CollisionMode { AllPairs, UniformGrid, NeighbourList, SweepAndPrune, HierarchicalGrid, IncrementalGrid, HashGrid };
+
+// Collision response. VelocitySwap is Particle3DCollision: each touching
+// pair swaps velocities and is pushed apart once, in broadphase order.
+// XPBD hands the contacts to an iterated, mass-weighted position solver
+// (see ContactSolver.h), which holds stacks and piles steadier.
+enum class ContactResponse { VelocitySwap, XPBD };
+
+// Force model. CentralAttractor is SetGravity's fixed point mass, the
+// others are mutual gravity between the particles (SimParams::mutualG)
+enum class GravityMode { CentralAttractor, BarnesHut, DirectSum, ParticleMesh, FastMultipole };
+
+// Integrator under the central attractor. Verlet is VerletIntegration
+// (and its SIMD kernels); Leapfrog to Omelyan are the splitting schemes of
+// SplittingIntegrators.h, stepped per particle in double. Leapfrog is the
+// same update as Verlet, without the float rounding between steps.
+// WisdomHolman moves each particle along its exact Kepler orbit about the
+// attractor (KeplerDrift.h), so steps can be a sizeable fraction of an
+// orbit; collisions act as kicks between the drifts. Under a mutual
+// gravity mode it keeps the attractor as the Kepler part and applies the
+// mutual forces as half kicks either side of the drift.
+enum class Integrator { Verlet, Leapfrog, ForestRuth, Yoshida4, Yoshida6, Omelyan, WisdomHolman };
+
+class Simulation{
+  public:
+    ParticleSystem particles;
+    SimParams params;
+
+    // particle i takes part in the simulation once elapsedTime >= spawnTimes[i]
+    std::vector<float> spawnTimes;
+    float elapsedTime = 0.0f;
+
+    CollisionMode collisionMode = CollisionMode::UniformGrid;
+    ContactResponse contactResponse = ContactResponse::VelocitySwap;
+    GravityMode gravityMode = GravityMode::CentralAttractor;
+    Integrator integrator = Integrator::Verlet;
+
+    // mutual gravity solvers, public so their settings can be tuned
+    BarnesHut barnesHut;
+    DirectSummation directSum;
+    ParticleMesh particleMesh;
+    FastMultipole fastMultipole;
+
+    // Verlet lists for CollisionMode::NeighbourList, public for the skin and statistics
+    NeighbourList neighbourList;
+
+    // sorted intervals for CollisionMode::SweepAndPrune
+    SweepAndPrune sweepAndPrune;
+
+    // per-size-class grids for CollisionMode::HierarchicalGrid
+    HierarchicalGrid hierarchicalGrid;
+
+    // persistent cells for CollisionMode::IncrementalGrid
+    IncrementalGrid incrementalGrid;
+
+    // sparse cells for CollisionMode::HashGrid, for open domains
+    HashGrid hashGrid;
+
+    // ContactResponse::XPBD, public for the iteration count and compliance
+    ContactSolver contactSolver;
+
+    // Integrate runs of consecutive particles with the vectorised kernels
+    // (SimdKernels.h), else particle by particle
+    bool useSimdKernels = true;
+
+    // Continuous collision detection: pairs whose straight paths over the
+    // step touched are resolved at their time of impact (SweptCollisions.h)
+    // and the boundary reflects particles where their paths crossed it
+    // (checkSweptSphereCollision), so fast particles do not tunnel at
+    // large steps. The discrete pass still runs for resting contacts.
+    bool continuousCollisions = false;
+    SweptCollisions sweptCollisions;
+
+    // Event-driven hard spheres (HardSpheres.h): step() moves the spawned
+    // particles on from collision to collision instead, exactly and
+    // elastically, in free flight. Gravity, damping, sleeping and the
+    // collision settings above are not used while it is on.
+    bool eventDriven = false;
+    HardSpheres hardSpheres;
+
+    // Power-of-two block timesteps under the central attractor. A particle
+    // at level L moves in substeps of deltaTime / 2^L, and only the levels
+    // due at a substep are integrated. Its level is the coarsest with
+    //   deltaTime / 2^L <= timestepAccuracy * min(sqrt(d / |a|), d / |v|)
+    // for d the distance to the attractor, so particles skimming past it
+    // get fine steps and distant ones stay at level 0. Levels get finer
+    // after any substep, from the time the particle's old level is next
+    // due, and coarser only at the start of a step, when everyone is
+    // synchronised. Collisions and the boundary still run once per step.
+    // 0 levels gives everyone one step.
+    int maxTimestepLevel = 0;
+    float timestepAccuracy = 0.25f;
+
+    // particles at each level at the end of the last step, and the Verlet
+    // updates per particle it took
+    std::vector<int> levelCounts;
+    double lastUpdatesPerParticle = 1.0;
+
+    // largest difference between the time a particle was integrated for in
+    // the last step and the step itself; zero unless the levels are broken
+    double lastTimeMismatch = 0.0;
+
+    // Put settled contact islands to sleep (SleepIslands.h). Only with the
+    // central attractor; sleepIslands holds the thresholds and counts.
+    bool allowSleeping = false;
+    SleepIslands sleepIslands;
+
+    // Test candidate pairs 16 at a time on squared distances before the
+    // response (Narrowphase.h), else call Particle3DCollision on each.
+    // Batching only pays while contacts are rare: in a dense pile most
+    // candidates end up in the exact check anyway. So it is used for a
+    // step only if the previous one had at most this fraction of contacts;
+    // both paths give the same result.
+    bool batchedNarrowphase = true;
+    float batchedMaxContactRatio = 0.05f;
+
+    // candidate pairs from the broadphase and real contacts among them, last step
+    long long lastCandidates = 0;
+    long long lastContacts = 0;
+    bool lastBatched = false;
+
+    // Every reorderInterval steps the particles are sorted into Morton
+    // (Z-order) so neighbours in space are neighbours in memory; 0 turns
+    // it off. Indices change, particles.indexOf(id) follows a particle.
+    int reorderInterval = 128;
+
+    // indices of the spawned particles, and of those not asleep, refreshed by step()
+    std::vector<int> activeParticles;
+    std::vector<int> awakeParticles;
+
+    Simulation();
+
+    // Threads used by the per-particle passes, including the caller.
+    // 1 runs everything on the calling thread, 0 uses every core.
+    void setThreadCount(int numThreads);
+    int threadCount() const { return pool->size(); }
+
+    // Returns the particle's id (its index until the first reorder)
+    int addParticle(glm::vec3 pos, glm::vec3 vel, float m, float r, float spawnTime = 0.0f);
+
+    // Sort the spawned particles by Morton key of their position, ahead
+    // of the unspawned ones, which keep their relative order. Called by
+    // step() every reorderInterval steps.
+    void reorderParticles();
+
+    // Advance the simulation by deltaTime: integration and gravity,
+    // particle collisions, then the boundary sphere.
+    void step(float deltaTime);
+
+    // Sum of 1/2 m v^2 over the spawned particles
+    double kineticEnergy() const;
+
+  private:
+    SpatialGrid grid;
+    std::unique_ptr<ThreadPool> pool;
+
+    // accelerations in ps.ax/ay/az were computed by this mode for this many particles
+    GravityMode forceMode = GravityMode::CentralAttractor;
+    int forceCount = -1;
+
+    // Morton reorder scratch, reused between reorders
+    int stepsSinceReorder = 0;
+    RadixSorter sorter;
+    std::vector<uint64_t> reorderKeys;
+    std::vector<int> reorderOrder;
+    AlignedVector<float> columnScratch;
+    std::vector<int> idScratch;
+    std::vector<float> spawnScratch;
+    std::vector<glm::dvec3> doubleScratch;
+
+    // where integrateList cuts its list into runs for the vector kernel
+    std::vector<int> integrationRuns;
+
+    // one narrowphase batch per pool thread
+    std::vector<ContactBatch> contactBatches;
+
+    bool sleepingActive = false;
+
+    // the last step was event-driven, so hardSpheres is up to date
+    bool hardSpheresCurrent = false;
+
+    // the state in double of the integrators other than Verlet; a
+    // particle's is used while its float position and velocity still
+    // round from it
+    std::vector<glm::dvec3> doublePosition, doubleVelocity;
+
+    // block timestep levels and the particles at each; heldLists[L] holds
+    // those refined out of level L until L is next due, and stepTime the
+    // time each has been integrated for in this step
+    std::vector<uint8_t> particleLevel;
+    std::vector<std::vector<int>> levelLists, heldLists;
+    std::vector<double> stepTime;
+
+    void collectAwakeParticles();
+    void awakeSetChanged();
+    void collideParticles(float deltaTime);
+    void resolveCandidatePairs();
+    void integrateCentral(float deltaTime);
+    void integrateBlocks(float deltaTime);
+    int timestepLevel(int i, float deltaTime) const;
+    void integrateList(const int* indices, int count, float deltaTime);
+    template <typename Scheme>
+    void integrateSplitting(const int* indices, int count, float deltaTime);
+    void computeCentralAccelerations();
+    void driftKepler(const int* indices, int count, float deltaTime);
+    void resizeDoubleState();
+    void loadDoubleState(int i, glm::dvec3& p, glm::dvec3& v) const;
+    void storeDoubleState(int i, glm::dvec3 p, glm::dvec3 v);
+    void integrateMutual(float deltaTime);
+    void computeMutualAccelerations();
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+
+/*
+ * Fixed-timestep simulation clock.
+ *
+ * Frame time is banked in an accumulator and paid out in whole steps of
+ * fixedDeltaTime, so the physics never sees the render frame rate. At most
+ * maxSubsteps are run per frame; when a frame would need more (a hitch, or
+ * physics slower than real time) the surplus is dropped instead of being
+ * carried over, which keeps the clock out of the spiral of death.
+ */
+class SimulationClock{
+  public:
+    double fixedDeltaTime = 1.0 / 240.0;
+    int maxSubsteps = 8;
+
+    // frame times above this are treated as a hitch and clamped
+    double maxFrameTime = 0.25;
+
+    double accumulator = 0.0;
+
+    // bookkeeping for the last advance() and since construction
+    int lastSubsteps = 0;
+    double droppedTime = 0.0;
+
+    SimulationClock(double fixedDt = 1.0 / 240.0, int substepCap = 8){
+      fixedDeltaTime = fixedDt;
+      maxSubsteps = substepCap;
+    }
+
+    // Bank frameTime and return how many fixed steps to run this frame.
+    int advance(double frameTime){
+      if(frameTime > maxFrameTime){
+        droppedTime += frameTime - maxFrameTime;
+        frameTime = maxFrameTime;
+      }
+      accumulator += std::max(frameTime, 0.0);
+
+      int steps = (int)(accumulator / fixedDeltaTime);
+      accumulator -= steps * fixedDeltaTime;
+
+      if(steps > maxSubsteps){
+        droppedTime += (steps - maxSubsteps) * fixedDeltaTime;
+        steps = maxSubsteps;
+      }
+
+      lastSubsteps = steps;
+      return steps;
+    }
+
+    // Fraction of a step left in the accumulator, for render interpolation
+    double alpha() const {
+      return accumulator / fixedDeltaTime;
+    }
+};
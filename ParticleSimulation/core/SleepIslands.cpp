@@ -0,0 +1,257 @@
+#include "SleepIslands.h"
+
+#include <algorithm>
+#include <climits>
+
+// awake particles per parallel-for chunk in the wake test
+static const int wakeGrain = 1024;
+
+void SleepIslands::resize(int n){
+    if (n < (int)particleIsland.size()){
+        wakeAll();
+        particleIsland.clear();
+        calmSteps.clear();
+    }
+
+    particleIsland.resize(n, -1);
+    calmSteps.resize(n, 0);
+    parent.resize(n);
+    islandSize.resize(n);
+    islandCalm.resize(n);
+    rootIsland.resize(n);
+    islandSupported.resize(n);
+    islandVelocity.resize(n);
+    islandAcceleration.resize(n);
+    onSleeper.resize(n, 0);
+}
+
+void SleepIslands::wakeIsland(int island){
+    for(int i : islands[island]){
+        particleIsland[i] = -1;
+        calmSteps[i] = 0;
+    }
+    numSleeping -= (int)islands[island].size();
+    islands[island].clear();
+    freeIslands.push_back(island);
+    gridDirty = true;
+}
+
+void SleepIslands::wakeAll(){
+    for(int island = 0; island < (int)islands.size(); island++){
+        if (!islands[island].empty()){
+            wakeIsland(island);
+        }
+    }
+}
+
+bool SleepIslands::wakeTouched(ParticleSystem& ps, const std::vector<int>& awake, float deltaTime, ThreadPool& pool){
+    restingOnSleepers = numSleeping > 0;
+    if (numSleeping == 0){
+        return false;
+    }
+
+    // cells sized for the largest particle, awake or not
+    if (gridDirty){
+        sleepingList.clear();
+        float maxRadius = 0.0f;
+        for(int i = 0; i < (int)particleIsland.size(); i++){
+            maxRadius = std::max(maxRadius, ps.radius[i]);
+            if (particleIsland[i] >= 0){
+                sleepingList.push_back(i);
+            }
+        }
+        sleepingGrid.build(sleepingList, [&](int i){ return ps.position(i); }, maxRadius);
+        gridDirty = false;
+    }
+
+    const SpatialGrid& grid = sleepingGrid;
+    threadWakes.resize(pool.size());
+    for(std::vector<int>& wakes : threadWakes){
+        wakes.clear();
+    }
+
+    pool.parallelForThreads(0, (int)awake.size(), wakeGrain, [&](int begin, int end, int thread){
+        std::vector<int>& wakes = threadWakes[thread];
+        for(int k = begin; k < end; k++){
+            int i = awake[k];
+            onSleeper[i] = 0;
+            glm::ivec3 c = glm::ivec3(glm::floor((ps.position(i) - grid.origin) / grid.cellSize));
+            if (c.x < -1 || c.y < -1 || c.z < -1 || c.x > grid.dimX || c.y > grid.dimY || c.z > grid.dimZ){
+                continue;
+            }
+
+            // no faster than a resting particle: it lands on the sleepers rather than waking them
+            float kick = glm::length(ps.acceleration(i)) * deltaTime;
+            bool gentle = glm::dot(ps.velocity(i), ps.velocity(i)) <= 2.0f * energyThreshold + kick * kick;
+
+            for(int z = std::max(c.z - 1, 0); z <= std::min(c.z + 1, grid.dimZ - 1); z++){
+                for(int y = std::max(c.y - 1, 0); y <= std::min(c.y + 1, grid.dimY - 1); y++){
+                    for(int x = std::max(c.x - 1, 0); x <= std::min(c.x + 1, grid.dimX - 1); x++){
+                        int cell = grid.cellIndex(x, y, z);
+                        for(int q = grid.cellStart[cell]; q < grid.cellStart[cell + 1]; q++){
+                            int j = grid.cellParticles[q];
+                            float dx = ps.px[j] - ps.px[i], dy = ps.py[j] - ps.py[i], dz = ps.pz[j] - ps.pz[i];
+                            float contact = ps.radius[i] + ps.radius[j];
+                            if (dx*dx + dy*dy + dz*dz >= contact * contact){
+                                continue;
+                            }
+                            if (!gentle){
+                                wakes.push_back(particleIsland[j]);
+                                continue;
+                            }
+
+                            // as against a wall: out of the overlap, and no approach speed left
+                            glm::vec3 normal = ps.position(i) - ps.position(j);
+                            float distance = glm::length(normal);
+                            if (distance > 0.0f){
+                                normal /= distance;
+                                ps.setPosition(i, ps.position(i) + normal * (contact - distance));
+                                float approach = glm::dot(ps.velocity(i), normal);
+                                if (approach < 0.0f){
+                                    ps.setVelocity(i, ps.velocity(i) - normal * approach);
+                                }
+                            }
+                            onSleeper[i] = 1;
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    // in island order, so the free list does not depend on the thread count
+    scratch.clear();
+    for(const std::vector<int>& wakes : threadWakes){
+        scratch.insert(scratch.end(), wakes.begin(), wakes.end());
+    }
+    std::sort(scratch.begin(), scratch.end());
+    scratch.erase(std::unique(scratch.begin(), scratch.end()), scratch.end());
+
+    for(int island : scratch){
+        wakeIsland(island);
+    }
+    return !scratch.empty();
+}
+
+void SleepIslands::beginIslands(const std::vector<int>& awake){
+    for(int i : awake){
+        parent[i] = i;
+        islandSize[i] = 1;
+    }
+}
+
+bool SleepIslands::endIslands(ParticleSystem& ps, const std::vector<int>& awake, const SimParams& params, float deltaTime){
+    awakeSteps += (long long)awake.size();
+    particleSteps += (long long)awake.size() + numSleeping;
+
+    // the mean velocity and acceleration of each island, kept at its root
+    for(int i : awake){
+        islandVelocity[i] = glm::vec3(0.0f);
+        islandAcceleration[i] = glm::vec3(0.0f);
+        islandCalm[i] = INT_MAX;
+        islandSupported[i] = 0;
+    }
+    for(int i : awake){
+        int root = find(i);
+        islandVelocity[root] += ps.velocity(i);
+        islandAcceleration[root] += ps.acceleration(i);
+    }
+    for(int i : awake){
+        if (parent[i] == i){
+            islandVelocity[i] /= (float)islandSize[i];
+            islandAcceleration[i] /= (float)islandSize[i];
+        }
+    }
+
+    // then the least calm member and the support, calm meaning slow
+    // against the island as a whole, and the whole slow as well
+    float core = params.minGravityDistance;
+    for(int i : awake){
+        int root = find(i);
+        glm::vec3 relative = ps.velocity(i) - islandVelocity[root];
+        float kick = glm::length(ps.acceleration(i) - islandAcceleration[root]) * deltaTime;
+        float meanKick = glm::length(islandAcceleration[root]) * deltaTime;
+        bool calm = glm::dot(relative, relative) <= 2.0f * energyThreshold + kick * kick &&
+                    glm::dot(islandVelocity[root], islandVelocity[root]) <= 2.0f * energyThreshold + meanKick * meanKick;
+        calmSteps[i] = calm ? calmSteps[i] + 1 : 0;
+        islandCalm[root] = std::min(islandCalm[root], calmSteps[i]);
+
+        // checkSphereCollision leaves a resting particle exactly on the
+        // boundary; a pile in the well rests on the attractor's core
+        bool onBoundary = params.sphereBoundary && glm::length(ps.position(i)) + 1.05f * ps.radius[i] >= params.boundaryRadius;
+        bool onCore = glm::length(ps.position(i) - params.gravityCenter) < core + ps.radius[i];
+        if (onBoundary || onCore || (restingOnSleepers && onSleeper[i])){
+            islandSupported[root] = 1;
+        }
+    }
+
+    lastIslands = 0;
+    for(int i : awake){
+        if (parent[i] == i){
+            rootIsland[i] = -1;
+            lastIslands++;
+        }
+    }
+
+    bool slept = false;
+    for(int i : awake){
+        int root = find(i);
+        if (!islandSupported[root] || islandCalm[root] < sleepSteps){
+            continue;
+        }
+
+        // numbered on first sight, in particle order
+        if (rootIsland[root] < 0){
+            if (freeIslands.empty()){
+                rootIsland[root] = (int)islands.size();
+                islands.emplace_back();
+            }
+            else{
+                rootIsland[root] = freeIslands.back();
+                freeIslands.pop_back();
+            }
+        }
+
+        int island = rootIsland[root];
+        islands[island].push_back(i);
+        particleIsland[i] = island;
+        calmSteps[i] = 0;
+        ps.setVelocity(i, glm::vec3(0.0f));
+        numSleeping++;
+        slept = true;
+    }
+
+    if (slept){
+        gridDirty = true;
+    }
+    return slept;
+}
+
+void SleepIslands::permute(const std::vector<int>& order){
+    int n = (int)order.size();
+    resize(n);
+
+    // old index -> new index
+    scratch.resize(n);
+    for(int k = 0; k < n; k++){
+        scratch[order[k]] = k;
+    }
+
+    for(std::vector<int>& members : islands){
+        for(int& i : members){
+            i = scratch[i];
+        }
+    }
+
+    std::vector<int> moved(n);
+    for(int k = 0; k < n; k++){
+        moved[k] = particleIsland[order[k]];
+    }
+    particleIsland.swap(moved);
+    for(int k = 0; k < n; k++){
+        moved[k] = calmSteps[order[k]];
+    }
+    calmSteps.swap(moved);
+
+    gridDirty = true;
+}
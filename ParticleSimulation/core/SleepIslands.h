@@ -0,0 +1,112 @@
+#pragma once
+
+#include "ParticleSystem.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+#include <utility>
+#include <vector>
+
+/*
+ * Sleeping islands: settled groups of particles drop out of the step.
+ *
+ * Each step the contacts between awake particles are joined into islands
+ * with a union-find, as Box2D does. Every particle counts the steps in a
+ * row its kinetic energy per unit mass, relative to its island's mean
+ * velocity, has stayed below energyThreshold (and the island's mean
+ * velocity has too), and an island whose least calm member has reached
+ * sleepSteps goes to sleep: its velocities are zeroed and its particles
+ * are skipped by integration, gravity, collisions and the boundary. A
+ * resting particle still picks up |a| dt of speed every step before its
+ * contacts take it away again, so that much is allowed on top of the
+ * threshold. The boundary, the attractor's core (within
+ * minGravityDistance of gravityCenter, where a pile in the well rests)
+ * and sleeping particles support an island; one off them (slowly falling
+ * from rest, say) stays awake.
+ *
+ * Sleeping particles are binned into a grid of their own, rebuilt only
+ * when the sleeping set changes. An awake particle that touches one
+ * before the collision pass wakes its whole island, unless it moves no
+ * faster than a resting particle would: then it is pushed out and
+ * stopped as if by a wall, so stragglers settling onto a sleeping pile
+ * do not keep waking all of it. Islands are numbered in particle order,
+ * so the result does not depend on the thread count.
+ */
+class SleepIslands{
+  public:
+    int sleepSteps = 60;
+    float energyThreshold = 50.0f;   // kinetic energy per unit mass, units^2/s^2
+
+    // statistics
+    int sleepingCount() const { return numSleeping; }
+    int sleepingIslandCount() const { return (int)islands.size() - (int)freeIslands.size(); }
+    int lastIslands = 0;             // awake islands at the last update
+    long long awakeSteps = 0, particleSteps = 0;
+
+    // fraction of the spawned particles simulated per step, over all updates
+    double awakeFraction() const { return particleSteps > 0 ? (double)awakeSteps / particleSteps : 1.0; }
+
+    bool isSleeping(int i) const { return particleIsland[i] >= 0; }
+
+    // Track n particles; new ones start awake
+    void resize(int n);
+
+    // Wake the islands touched by an awake particle, or land it on them if
+    // it is slow enough; true if any woke
+    bool wakeTouched(ParticleSystem& ps, const std::vector<int>& awake, float deltaTime, ThreadPool& pool);
+
+    // Islands of one step: begin, link every touching pair, then end,
+    // which puts the calm islands to sleep and returns true if any did
+    void beginIslands(const std::vector<int>& awake);
+    void link(int i, int j){
+      int a = find(i), b = find(j);
+      if (a == b) return;
+      if (islandSize[a] < islandSize[b]) std::swap(a, b);
+      parent[b] = a;
+      islandSize[a] += islandSize[b];
+    }
+    bool endIslands(ParticleSystem& ps, const std::vector<int>& awake, const SimParams& params, float deltaTime);
+
+    void wakeAll();
+
+    // The particles were reordered: the one now at k was at order[k]
+    void permute(const std::vector<int>& order);
+
+  private:
+    // sleeping island of each particle, -1 while awake
+    std::vector<int> particleIsland;
+    std::vector<std::vector<int>> islands;
+    std::vector<int> freeIslands;
+    int numSleeping = 0;
+
+    // consecutive calm steps of each awake particle
+    std::vector<int> calmSteps;
+
+    // union-find over the awake particles, and per-root minimum, support
+    // and mean motion
+    std::vector<int> parent, islandSize;
+    std::vector<int> islandCalm, rootIsland;
+    std::vector<char> islandSupported;
+    std::vector<glm::vec3> islandVelocity, islandAcceleration;
+
+    // awake particles that landed on a sleeping one this step
+    std::vector<char> onSleeper;
+    bool restingOnSleepers = false;
+
+    // the sleeping particles, binned when the set changed
+    SpatialGrid sleepingGrid;
+    std::vector<int> sleepingList;
+    bool gridDirty = true;
+
+    std::vector<std::vector<int>> threadWakes;
+    std::vector<int> scratch;
+
+    int find(int i){
+      while (parent[i] != i){
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+      }
+      return i;
+    }
+
+    void wakeIsland(int island);
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/*
+ * Uniform grid broadphase.
+ *
+ * Particles are binned into cubic cells with a counting sort every
+ * step. The cell size is the largest particle diameter, so any two
+ * overlapping particles always sit in the same or adjacent cells and
+ * only the 27-cell neighbourhood has to be tested.
+ */
+class SpatialGrid{
+  public:
+    float cellSize = 1.0f;
+    glm::vec3 origin = glm::vec3(0.0f);
+    int dimX = 0, dimY = 0, dimZ = 0;
+
+    // cellStart[c] .. cellStart[c+1] indexes into cellParticles
+    std::vector<int> cellStart;
+    std::vector<int> cellParticles;
+
+    // cell index of each binned particle (parallel to the input list)
+    std::vector<int> particleCell;
+
+    // hard cap so a single runaway particle can't allocate a huge grid
+    int maxCells = 1 << 22;
+
+    int cellCount() const { return dimX * dimY * dimZ; }
+
+    int cellIndex(int x, int y, int z) const {
+      return (z * dimY + y) * dimX + x;
+    }
+
+    glm::ivec3 cellCoord(glm::vec3 position) const {
+      glm::vec3 local = (position - origin) / cellSize;
+      return glm::clamp(glm::ivec3(glm::floor(local)), glm::ivec3(0), glm::ivec3(dimX - 1, dimY - 1, dimZ - 1));
+    }
+
+    // Bin the particles listed in `indices`. getPosition(i) returns the
+    // position of particle i, maxRadius is the largest radius among them.
+    template <typename PositionFn>
+    void build(const std::vector<int>& indices, PositionFn getPosition, float maxRadius){
+      cellSize = std::max(2.0f * maxRadius, 1e-3f);
+
+      if(indices.empty()){
+        dimX = dimY = dimZ = 0;
+        cellStart.assign(1, 0);
+        cellParticles.clear();
+        particleCell.clear();
+        return;
+      }
+
+      // bounds of the occupied region, ignoring non-finite positions
+      glm::vec3 lo(std::numeric_limits<float>::max());
+      glm::vec3 hi(-std::numeric_limits<float>::max());
+      for(int i : indices){
+        glm::vec3 p = getPosition(i);
+        if(!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) continue;
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+      }
+      if(lo.x > hi.x) lo = hi = glm::vec3(0.0f);
+
+      fitCells(lo, hi);
+
+      // counting sort: histogram, exclusive prefix sum, scatter
+      int numCells = cellCount();
+      cellStart.assign(numCells + 1, 0);
+      particleCell.resize(indices.size());
+
+      for(size_t k = 0; k < indices.size(); k++){
+        glm::ivec3 c = cellCoord(getPosition(indices[k]));
+        particleCell[k] = cellIndex(c.x, c.y, c.z);
+        cellStart[particleCell[k] + 1]++;
+      }
+
+      for(int c = 0; c < numCells; c++){
+        cellStart[c + 1] += cellStart[c];
+      }
+
+      cellParticles.resize(indices.size());
+      std::vector<int>& cursor = scratch;
+      cursor.assign(cellStart.begin(), cellStart.end() - 1);
+      for(size_t k = 0; k < indices.size(); k++){
+        cellParticles[cursor[particleCell[k]]++] = indices[k];
+      }
+    }
+
+    // Cover [lo, hi] with cells of cellSize, doubled until the grid fits
+    // in maxCells. Dimensions are worked out in double so a huge extent
+    // saturates instead of overflowing int.
+    void fitCells(glm::vec3 lo, glm::vec3 hi){
+      glm::dvec3 extent = glm::dvec3(hi) - glm::dvec3(lo);
+      double size = cellSize;
+      glm::dvec3 dims;
+      while(true){
+        dims = glm::floor(extent / size) + 1.0;
+        if(dims.x * dims.y * dims.z <= (double)maxCells) break;
+        size *= 2.0;
+      }
+      cellSize = (float)size;
+      dimX = (int)dims.x;
+      dimY = (int)dims.y;
+      dimZ = (int)dims.z;
+      origin = lo;
+    }
+
+    // Visit every candidate pair once, cell by cell.
+    template <typename PairFn>
+    void forEachPair(PairFn visit) const {
+      for(int z = 0; z < dimZ; z++){
+        for(int y = 0; y < dimY; y++){
+          for(int x = 0; x < dimX; x++){
+            forEachPairInCell(x, y, z, visit);
+          }
+        }
+      }
+    }
+
+    // the "forward" half of the 3x3x3 stencil, without the cell itself
+    static constexpr int forward[13][3] = {
+      { 1, 0, 0}, {-1, 1, 0}, { 0, 1, 0}, { 1, 1, 0},
+      {-1,-1, 1}, { 0,-1, 1}, { 1,-1, 1},
+      {-1, 0, 1}, { 0, 0, 1}, { 1, 0, 1},
+      {-1, 1, 1}, { 0, 1, 1}, { 1, 1, 1}
+    };
+
+    // Pairs owned by one cell: the cell with itself and with the 13
+    // forward neighbours. Only particles in cells within one step of
+    // (x, y, z) are touched.
+    template <typename PairFn>
+    void forEachPairInCell(int x, int y, int z, PairFn visit) const {
+      int c = cellIndex(x, y, z);
+      int begin = cellStart[c], end = cellStart[c + 1];
+      if(begin == end) return;
+
+      // pairs inside the cell
+      for(int a = begin; a < end; a++){
+        for(int b = a + 1; b < end; b++){
+          visit(cellParticles[a], cellParticles[b]);
+        }
+      }
+
+      // pairs against the forward neighbours
+      for(const auto& o : forward){
+        int nx = x + o[0], ny = y + o[1], nz = z + o[2];
+        if(nx < 0 || ny < 0 || nz < 0 || nx >= dimX || ny >= dimY || nz >= dimZ) continue;
+
+        int n = cellIndex(nx, ny, nz);
+        for(int a = begin; a < end; a++){
+          for(int b = cellStart[n]; b < cellStart[n + 1]; b++){
+            visit(cellParticles[a], cellParticles[b]);
+          }
+        }
+      }
+    }
+
+    /*
+     * Colour scheduling for lock-free parallel pair resolution.
+     *
+     * Cells are grouped into 2x2x2 blocks and blocks are coloured by the
+     * parity of their block coordinates (8 colours). A block only touches
+     * particles within one cell of itself, so two blocks of the same
+     * colour (at least 4 cells apart on some axis) never share a particle
+     * and can be resolved concurrently. Within a block, cells and pairs
+     * are always visited in the same order, so the result does not depend
+     * on how blocks are spread over threads.
+     */
+    static const int numColours = 8;
+
+    // Number of blocks with the given colour
+    int colourBlockCount(int colour) const {
+      return colourBlocks(dimX, colour & 1) * colourBlocks(dimY, (colour >> 1) & 1) * colourBlocks(dimZ, (colour >> 2) & 1);
+    }
+
+    // Visit the cells (x, y, z) of the k-th block of a colour
+    template <typename CellFn>
+    void forEachCellInColourBlock(int colour, int k, CellFn visit) const {
+      int cx = colour & 1, cy = (colour >> 1) & 1, cz = (colour >> 2) & 1;
+      int nx = colourBlocks(dimX, cx), ny = colourBlocks(dimY, cy);
+
+      int bx = 2 * (k % nx) + cx;
+      int by = 2 * ((k / nx) % ny) + cy;
+      int bz = 2 * (k / (nx * ny)) + cz;
+
+      for(int z = 2 * bz; z < std::min(2 * bz + 2, dimZ); z++){
+        for(int y = 2 * by; y < std::min(2 * by + 2, dimY); y++){
+          for(int x = 2 * bx; x < std::min(2 * bx + 2, dimX); x++){
+            visit(x, y, z);
+          }
+        }
+      }
+    }
+
+    // Colour of the block holding cell (x, y, z); k receives the block's
+    // number within that colour, as used by forEachCellInColourBlock
+    int colourBlockOf(int x, int y, int z, int& k) const {
+      int bx = x / 2, by = y / 2, bz = z / 2;
+      int cx = bx & 1, cy = by & 1, cz = bz & 1;
+      int nx = colourBlocks(dimX, cx), ny = colourBlocks(dimY, cy);
+      k = ((bz / 2) * ny + by / 2) * nx + bx / 2;
+      return cx | (cy << 1) | (cz << 2);
+    }
+
+    // Visit the pairs of the k-th block of a colour
+    template <typename PairFn>
+    void forEachPairInColourBlock(int colour, int k, PairFn visit) const {
+      forEachCellInColourBlock(colour, k, [&](int x, int y, int z){
+        forEachPairInCell(x, y, z, visit);
+      });
+    }
+
+  private:
+    std::vector<int> scratch;
+
+    // blocks along an axis of `dim` cells whose block coordinate has the given parity
+    static int colourBlocks(int dim, int parity){
+      int blocks = (dim + 1) / 2;
+      return (blocks - parity + 1) / 2;
+    }
+};
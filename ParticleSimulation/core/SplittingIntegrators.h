@@ -0,0 +1,191 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cmath>
+#include <utility>
+
+/*
+ * Symplectic splitting integrators composed at compile time.
+ *
+ * A scheme is a fixed sequence of drifts (p += c v dt) and kicks
+ * (v += d a(p) dt), written as
+ *   D(drift[0]) K(kick[0]) D(drift[1]) ... K(kick[n-1]) D(drift[n])
+ * with constexpr coefficients. splittingStep() expands the sequence with
+ * a fold over the stage indices, so each scheme compiles to straight-line
+ * code with the acceleration function inlined, and a force is only
+ * evaluated after a drift that is not zero.
+ *
+ * Higher orders are built by Composition<Base, Weights>, which runs the
+ * base scheme once per weight with its coefficients scaled (Yoshida's
+ * method) and merges the kicks that end up with no drift between them.
+ * Composing the kick-first leapfrog keeps it first-same-as-last: the
+ * closing kick's force is the next step's opening one, which the caller
+ * keeps between steps (Simulation keeps it in ax/ay/az).
+ *
+ *   Leapfrog     order 2, 1 force evaluation per step (velocity Verlet)
+ *   ForestRuth   order 4, 3: triple jump of drift-kick-drift leapfrog
+ *   Yoshida4     order 4, 3: triple jump of kick-drift-kick leapfrog
+ *   Yoshida6     order 6, 7: Yoshida's solution A, seven leapfrogs
+ *   Omelyan      order 4, 4: Omelyan, Mryglod and Folk's PEFRL, with an
+ *                error constant about a hundred times below Forest-Ruth
+ */
+
+// D(drift[0]) K(kick[0]) ... K(kick[Kicks - 1]) D(drift[Kicks])
+template <int Kicks>
+struct SplittingSequence{
+  double drift[Kicks + 1];
+  double kick[Kicks];
+};
+
+// Kick-drift-kick leapfrog
+struct Leapfrog{
+  static constexpr int order = 2;
+  static constexpr int kicks = 2;
+  static constexpr SplittingSequence<2> sequence = { { 0.0, 1.0, 0.0 }, { 0.5, 0.5 } };
+};
+
+// Drift-kick-drift leapfrog, the base of Forest-Ruth
+struct PositionLeapfrog{
+  static constexpr int order = 2;
+  static constexpr int kicks = 1;
+  static constexpr SplittingSequence<1> sequence = { { 0.5, 0.5 }, { 1.0 } };
+};
+
+// Weights w1, w0, w1 with 2 w1 + w0 = 1 and 2 w1^3 + w0^3 = 0:
+// w1 = 1 / (2 - 2^(1/3)), which takes a symmetric order 2 scheme to order 4
+struct TripleJumpWeights{
+  static constexpr int order = 4;
+  static constexpr int count = 3;
+  static constexpr double weights[3] = { 1.3512071919596578, -1.7024143839193155, 1.3512071919596578 };
+};
+
+// Yoshida (1990), solution A: w3 w2 w1 w0 w1 w2 w3 with w0 = 1 - 2 (w1 + w2 + w3)
+struct Yoshida6Weights{
+  static constexpr int order = 6;
+  static constexpr int count = 7;
+  static constexpr double weights[7] = {
+    0.784513610477560, 0.235573213359357, -1.17767998417887, 1.31518632068391,
+    -1.17767998417887, 0.235573213359357, 0.784513610477560
+  };
+};
+
+// The base sequence once per weight, scaled by it, end to end. The last
+// drift of one copy and the first of the next add up to one.
+template <int Kicks, int Count>
+constexpr SplittingSequence<Kicks * Count> concatenateSequence(const SplittingSequence<Kicks>& base, const double (&weights)[Count]){
+  SplittingSequence<Kicks * Count> out{};
+  for(int c = 0; c < Count; c++){
+    for(int k = 0; k < Kicks; k++){
+      out.kick[c * Kicks + k] = weights[c] * base.kick[k];
+    }
+    for(int k = 0; k <= Kicks; k++){
+      out.drift[c * Kicks + k] += weights[c] * base.drift[k];
+    }
+  }
+  return out;
+}
+
+// Kicks left once those with no drift between them are merged
+template <int Kicks>
+constexpr int mergedKickCount(const SplittingSequence<Kicks>& sequence){
+  int kicks = Kicks;
+  for(int k = 1; k < Kicks; k++){
+    if (sequence.drift[k] == 0.0) kicks--;
+  }
+  return kicks;
+}
+
+template <int Merged, int Kicks>
+constexpr SplittingSequence<Merged> mergeKicks(const SplittingSequence<Kicks>& sequence){
+  SplittingSequence<Merged> out{};
+  int m = 0;
+  out.drift[0] = sequence.drift[0];
+  out.kick[0] = sequence.kick[0];
+  for(int k = 1; k < Kicks; k++){
+    if (sequence.drift[k] == 0.0){
+      out.kick[m] += sequence.kick[k];
+    }
+    else{
+      m++;
+      out.drift[m] = sequence.drift[k];
+      out.kick[m] = sequence.kick[k];
+    }
+  }
+  out.drift[Merged] = sequence.drift[Kicks];
+  return out;
+}
+
+template <typename Base, typename Weights>
+struct Composition{
+  static constexpr int order = Weights::order;
+  static constexpr int kicks = mergedKickCount(concatenateSequence(Base::sequence, Weights::weights));
+  static constexpr SplittingSequence<kicks> sequence = mergeKicks<kicks>(concatenateSequence(Base::sequence, Weights::weights));
+};
+
+using ForestRuth = Composition<PositionLeapfrog, TripleJumpWeights>;
+using Yoshida4 = Composition<Leapfrog, TripleJumpWeights>;
+using Yoshida6 = Composition<Leapfrog, Yoshida6Weights>;
+
+// Omelyan, Mryglod and Folk (2002), position-extended Forest-Ruth-like
+struct Omelyan{
+  static constexpr double xi = 0.1786178958448091;
+  static constexpr double lambda = -0.2123418310626054;
+  static constexpr double chi = -0.06626458266981849;
+
+  static constexpr int order = 4;
+  static constexpr int kicks = 4;
+  static constexpr SplittingSequence<4> sequence = {
+    { xi, chi, 1.0 - 2.0 * (chi + xi), chi, xi },
+    { 0.5 * (1.0 - 2.0 * lambda), lambda, lambda, 0.5 * (1.0 - 2.0 * lambda) }
+  };
+};
+
+// Drifts and kicks each add up to one whole step
+template <typename Scheme>
+constexpr bool isConsistent(){
+  double drifts = 0.0, kicks = 0.0;
+  for(int k = 0; k <= Scheme::kicks; k++) drifts += Scheme::sequence.drift[k];
+  for(int k = 0; k < Scheme::kicks; k++) kicks += Scheme::sequence.kick[k];
+  return drifts > 1.0 - 1e-12 && drifts < 1.0 + 1e-12 && kicks > 1.0 - 1e-12 && kicks < 1.0 + 1e-12;
+}
+
+static_assert(isConsistent<Leapfrog>() && isConsistent<PositionLeapfrog>(), "leapfrog coefficients");
+static_assert(isConsistent<ForestRuth>() && isConsistent<Yoshida4>() && isConsistent<Yoshida6>(), "composed coefficients");
+static_assert(isConsistent<Omelyan>(), "Omelyan coefficients");
+static_assert(ForestRuth::kicks == 3 && Yoshida4::kicks == 4 && Yoshida6::kicks == 8, "merged kicks");
+
+// Force evaluations per step once the first-same-as-last force is reused
+template <typename Scheme>
+constexpr int forceEvaluations(){
+  return Scheme::sequence.drift[0] == 0.0 && Scheme::sequence.drift[Scheme::kicks] == 0.0 ? Scheme::kicks - 1 : Scheme::kicks;
+}
+
+template <typename Scheme, int K, typename AccelFn>
+inline void splittingStage(glm::dvec3& p, glm::dvec3& v, glm::dvec3& a, double dt, AccelFn& accel){
+  constexpr double drift = Scheme::sequence.drift[K];
+  constexpr double kick = Scheme::sequence.kick[K];
+  if constexpr (drift != 0.0){
+    p += v * (drift * dt);
+    a = accel(p);
+  }
+  v += a * (kick * dt);
+}
+
+template <typename Scheme, typename AccelFn, std::size_t... K>
+inline void splittingStages(glm::dvec3& p, glm::dvec3& v, glm::dvec3& a, double dt, AccelFn& accel, std::index_sequence<K...>){
+  (splittingStage<Scheme, (int)K>(p, v, a, dt, accel), ...);
+}
+
+// One step of Scheme for a body at p moving at v. accel(p) returns the
+// acceleration at p. On entry a must be the acceleration at p if the
+// scheme opens with a kick; on return it is the last one evaluated, which
+// is the one at p for schemes that close with a kick.
+template <typename Scheme, typename AccelFn>
+inline void splittingStep(glm::dvec3& p, glm::dvec3& v, glm::dvec3& a, double dt, AccelFn accel){
+  splittingStages<Scheme>(p, v, a, dt, accel, std::make_index_sequence<Scheme::kicks>{});
+
+  constexpr double last = Scheme::sequence.drift[Scheme::kicks];
+  if constexpr (last != 0.0){
+    p += v * (last * dt);
+  }
+}
@@ -0,0 +1,136 @@
+#include "SweepAndPrune.h"
+
+#include <algorithm>
+
+// sorted intervals per parallel-for chunk in the sweep
+static const int sweepGrain = 2048;
+
+// the axis only changes when another one has this much more variance,
+// so a scene near a tie does not re-sort every step
+static const double axisHysteresis = 1.2;
+
+int SweepAndPrune::chooseAxis(const ParticleSystem& ps, const std::vector<int>& indices) const {
+    if (indices.empty()){
+        return axis < 0 ? 0 : axis;
+    }
+
+    double sum[3] = { 0.0, 0.0, 0.0 }, sumSq[3] = { 0.0, 0.0, 0.0 };
+    for(int i : indices){
+        const double p[3] = { ps.px[i], ps.py[i], ps.pz[i] };
+        for(int a = 0; a < 3; a++){
+            sum[a] += p[a];
+            sumSq[a] += p[a] * p[a];
+        }
+    }
+
+    double variance[3];
+    for(int a = 0; a < 3; a++){
+        double mean = sum[a] / indices.size();
+        variance[a] = sumSq[a] / indices.size() - mean * mean;
+    }
+
+    int best = (int)(std::max_element(variance, variance + 3) - variance);
+    if (axis >= 0 && variance[best] < axisHysteresis * variance[axis]){
+        return axis;
+    }
+    return best;
+}
+
+void SweepAndPrune::update(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool){
+    int n = (int)ps.size();
+
+    // particles were removed: start over
+    if ((int)tracked.size() > n){
+        intervals.clear();
+        tracked.clear();
+        axis = -1;
+    }
+    tracked.resize(n, 0);
+
+    // newly spawned particles join at the end, the sort moves them into place
+    for(int i : indices){
+        int id = ps.id[i];
+        if (!tracked[id]){
+            tracked[id] = 1;
+            intervals.push_back({ 0.0f, 0.0f, i, id });
+        }
+    }
+
+    int newAxis = chooseAxis(ps, indices);
+    bool resort = newAxis != axis;
+    axis = newAxis;
+
+    const float* position = axis == 0 ? ps.px.data() : (axis == 1 ? ps.py.data() : ps.pz.data());
+    int count = (int)intervals.size();
+
+    pool.parallelFor(0, count, sweepGrain, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            Interval& interval = intervals[k];
+            interval.index = ps.indexOf(interval.id);
+            float p = position[interval.index];
+            float r = ps.radius[interval.index];
+            interval.lo = p - r;
+            interval.hi = p + r;
+        }
+    });
+
+    lastSwaps = 0;
+    if (resort){
+        std::sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b){
+            return a.lo < b.lo || (a.lo == b.lo && a.id < b.id);
+        });
+    }
+    else{
+        // insertion sort: near-linear when the order barely changed
+        for(int k = 1; k < count; k++){
+            Interval moving = intervals[k];
+            int m = k;
+            while(m > 0 && intervals[m - 1].lo > moving.lo){
+                intervals[m] = intervals[m - 1];
+                m--;
+            }
+            intervals[m] = moving;
+            lastSwaps += k - m;
+        }
+    }
+
+    // sweep each chunk of the sorted order into its own pair buffer
+    int otherA = (axis + 1) % 3, otherB = (axis + 2) % 3;
+    const float* columns[3] = { ps.px.data(), ps.py.data(), ps.pz.data() };
+    const float* pa = columns[otherA];
+    const float* pb = columns[otherB];
+
+    int numChunks = (count + sweepGrain - 1) / sweepGrain;
+    if ((int)chunkPairs.size() < numChunks){
+        chunkPairs.resize(numChunks);
+    }
+
+    pool.parallelFor(0, numChunks, 1, [&](int first, int last){
+        for(int chunk = first; chunk < last; chunk++){
+            std::vector<int>& out = chunkPairs[chunk];
+            out.clear();
+
+            int end = std::min(count, (chunk + 1) * sweepGrain);
+            for(int k = chunk * sweepGrain; k < end; k++){
+                const Interval& a = intervals[k];
+                float ra = ps.radius[a.index];
+
+                for(int m = k + 1; m < count && intervals[m].lo <= a.hi; m++){
+                    int j = intervals[m].index;
+                    float reach = ra + ps.radius[j];
+                    float da = pa[a.index] - pa[j], db = pb[a.index] - pb[j];
+                    if (da <= reach && da >= -reach && db <= reach && db >= -reach){
+                        out.push_back(a.index);
+                        out.push_back(j);
+                    }
+                }
+            }
+        }
+    });
+
+    pairList.clear();
+    for(int chunk = 0; chunk < numChunks; chunk++){
+        pairList.insert(pairList.end(), chunkPairs[chunk].begin(), chunkPairs[chunk].end());
+    }
+    lastPairs = (int)pairList.size() / 2;
+}
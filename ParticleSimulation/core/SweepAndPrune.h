@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+#include <vector>
+
+/*
+ * Sweep-and-prune broadphase along one axis.
+ *
+ * Every particle contributes an interval [p - r, p + r] on the axis with
+ * the largest positional variance. The intervals are kept sorted by
+ * their lower endpoint between steps and refreshed with an insertion
+ * sort, which is close to linear while particles keep their order
+ * (streams, piles, slow motion). A change of axis re-sorts from scratch.
+ *
+ * The sweep runs in parallel over chunks of the sorted order: each
+ * interval is tested against the ones after it until their lower end
+ * passes its upper end. Pairs whose boxes also overlap on the other two
+ * axes are emitted in sorted order, independent of the thread count.
+ *
+ * Entries hold stable particle ids (ParticleSystem::id), so the order
+ * survives a Morton reorder of the particle arrays.
+ */
+class SweepAndPrune{
+  public:
+    // axis of the last update (0 = x, 1 = y, 2 = z)
+    int axis = -1;
+
+    // statistics of the last update
+    long long lastSwaps = 0;
+    int lastPairs = 0;
+
+    // Refresh and sort the intervals of the listed particles, then collect
+    // the overlapping pairs (particle indices) into pairs()
+    void update(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool);
+
+    // Start over on the next update, e.g. when particles left the list
+    void invalidate(){ intervals.clear(); tracked.clear(); axis = -1; }
+
+    // (i, j) index pairs of the last update, flattened
+    const std::vector<int>& pairs() const { return pairList; }
+
+  private:
+    struct Interval{
+      float lo, hi;
+      int index, id;
+    };
+
+    std::vector<Interval> intervals;
+    std::vector<char> tracked;      // by id: already has an interval
+    std::vector<std::vector<int>> chunkPairs;
+    std::vector<int> pairList;
+
+    int chooseAxis(const ParticleSystem& ps, const std::vector<int>& indices) const;
+};
@@ -0,0 +1,156 @@
+#include "SweptCollisions.h"
+
+#include <algorithm>
+#include <cmath>
+
+// particles per parallel-for chunk
+static const int particleGrain = 4096;
+
+void SweptCollisions::begin(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool){
+    pathX.resize(ps.size());
+    pathY.resize(ps.size());
+    pathZ.resize(ps.size());
+    pathTime.resize(ps.size());
+
+    pool.parallelFor(0, (int)indices.size(), particleGrain, [&](int begin, int end){
+        for(int k = begin; k < end; k++){
+            int i = indices[k];
+            pathX[i] = ps.px[i];
+            pathY[i] = ps.py[i];
+            pathZ[i] = ps.pz[i];
+            pathTime[i] = 0.0f;
+        }
+    });
+}
+
+void SweptCollisions::resolvePairs(ParticleSystem& ps, const std::vector<int>& indices, const SimParams& params, float deltaTime, ThreadPool& pool){
+    lastCandidates = 0;
+    lastImpacts = 0;
+    lastDeferred = 0;
+    lastPasses = 0;
+
+    // displacement per unit of step fraction along the current path
+    auto pathRate = [&](int i){ return (ps.position(i) - pathStart(i)) / std::max(1.0f - pathTime[i], 1e-6f); };
+
+    // bounding sphere of each path: its midpoint, radius plus half its length
+    auto midpoint = [&](int i){ return 0.5f * (pathStart(i) + ps.position(i)); };
+    auto sweptRadius = [&](int i){ return ps.radius[i] + 0.5f * glm::length(ps.position(i) - pathStart(i)); };
+
+    moved.assign(ps.size(), 1);
+    hit.resize(ps.size());
+
+    for(int pass = 0; pass < maxPasses; pass++){
+        lastPasses++;
+
+        float maxRadius = 0.0f;
+        for(int i : indices){
+            maxRadius = std::max(maxRadius, sweptRadius(i));
+        }
+        grid.build(indices, midpoint, maxRadius);
+
+        threadImpacts.resize(pool.size());
+        threadCandidates.assign(pool.size(), 0);
+        for(std::vector<Impact>& list : threadImpacts){
+            list.clear();
+        }
+
+        // read-only, so any split of the cells will do
+        pool.parallelForThreads(0, grid.dimZ, 1, [&](int begin, int end, int thread){
+            std::vector<Impact>& list = threadImpacts[thread];
+            long long candidates = 0;
+
+            for(int z = begin; z < end; z++){
+                for(int y = 0; y < grid.dimY; y++){
+                    for(int x = 0; x < grid.dimX; x++){
+                        grid.forEachPairInCell(x, y, z, [&](int i, int j){
+                            // paths unchanged since the last pass were tested then
+                            if (!moved[i] && !moved[j]){
+                                return;
+                            }
+                            float reach = sweptRadius(i) + sweptRadius(j);
+                            glm::vec3 between = midpoint(j) - midpoint(i);
+                            if (glm::dot(between, between) >= reach * reach){
+                                return;
+                            }
+                            candidates++;
+
+                            // separation d(tau) = d0 + e (tau - tau0) from the later path start on
+                            float tau0 = std::max(pathTime[i], pathTime[j]);
+                            glm::vec3 rateI = pathRate(i), rateJ = pathRate(j);
+                            glm::vec3 atI = pathStart(i) + rateI * (tau0 - pathTime[i]);
+                            glm::vec3 atJ = pathStart(j) + rateJ * (tau0 - pathTime[j]);
+                            glm::vec3 d0 = atJ - atI;
+                            glm::vec3 e = rateJ - rateI;
+
+                            // apart at tau0 and closing: the first root of |d(tau)| = r_i + r_j
+                            float contact = ps.radius[i] + ps.radius[j];
+                            float a = glm::dot(e, e);
+                            float b = 2.0f * glm::dot(d0, e);
+                            float c = glm::dot(d0, d0) - contact * contact;
+                            if (c <= 0.0f || b >= 0.0f){
+                                return;
+                            }
+                            float discriminant = b * b - 4.0f * a * c;
+                            if (discriminant < 0.0f){
+                                return;
+                            }
+                            float tau = tau0 + (-b - std::sqrt(discriminant)) / (2.0f * a);
+                            if (tau <= 1.0f){
+                                list.push_back(Impact{ tau, std::min(i, j), std::max(i, j) });
+                            }
+                        });
+                    }
+                }
+            }
+            threadCandidates[thread] += candidates;
+        });
+
+        impacts.clear();
+        for(int thread = 0; thread < pool.size(); thread++){
+            impacts.insert(impacts.end(), threadImpacts[thread].begin(), threadImpacts[thread].end());
+            lastCandidates += threadCandidates[thread];
+        }
+        if (impacts.empty()){
+            break;
+        }
+
+        std::sort(impacts.begin(), impacts.end(), [](const Impact& a, const Impact& b){
+            if (a.t != b.t) return a.t < b.t;
+            if (a.i != b.i) return a.i < b.i;
+            return a.j < b.j;
+        });
+
+        // one impact per particle per pass; the rest wait for the next
+        std::fill(hit.begin(), hit.end(), 0);
+        int deferred = 0;
+        for(const Impact& impact : impacts){
+            int i = impact.i, j = impact.j;
+            if (hit[i] || hit[j]){
+                deferred++;
+                continue;
+            }
+            hit[i] = hit[j] = 1;
+            lastImpacts++;
+
+            // to the touching positions, swap as Particle3DCollision does, and finish the step
+            glm::vec3 touchI = pathStart(i) + pathRate(i) * (impact.t - pathTime[i]);
+            glm::vec3 touchJ = pathStart(j) + pathRate(j) * (impact.t - pathTime[j]);
+            glm::vec3 velocityI = ps.velocity(j) * params.damping;
+            glm::vec3 velocityJ = ps.velocity(i) * params.damping;
+            float remaining = (1.0f - impact.t) * deltaTime;
+
+            ps.setVelocity(i, velocityI);
+            ps.setVelocity(j, velocityJ);
+            ps.setPosition(i, touchI + velocityI * remaining);
+            ps.setPosition(j, touchJ + velocityJ * remaining);
+            setPathStart(i, touchI, impact.t);
+            setPathStart(j, touchJ, impact.t);
+        }
+
+        lastDeferred = deferred;
+        if (deferred == 0){
+            break;
+        }
+        moved.swap(hit);
+    }
+}
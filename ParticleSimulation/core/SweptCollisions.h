@@ -0,0 +1,73 @@
+#pragma once
+
+#include "ParticleSystem.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+#include <vector>
+
+/*
+ * Continuous collision detection for particle pairs.
+ *
+ * The discrete pass only sees where particles end a step, so a pair
+ * closing faster than its contact distance per step can pass straight
+ * through. Here each particle's path over the step is taken as the
+ * straight line from where it started to where integration left it.
+ * Pairs whose swept bounding spheres meet are candidates, binned on the
+ * midpoints of the paths in a SpatialGrid sized for the longest path.
+ * Each candidate that is apart at the start gets its time of impact
+ * 0 <= t <= 1 from |d0 + t e| = r_i + r_j (d0 the separation at the
+ * start, e its change over the step, per unit of t).
+ *
+ * Impacts are resolved earliest first: both particles go back to their
+ * positions at t, take the usual velocity swap (Particle3DCollision), and
+ * move on along the new velocities for the rest of the step, so their
+ * paths now start at the impact. A particle takes one impact per pass;
+ * the pairs of particles that moved are tested again on their new paths
+ * in the next pass, up to maxPasses, and what is left goes to the
+ * discrete pass, which still runs afterwards for resting contacts. The
+ * impacts are sorted by time and pair, so the result does not depend on
+ * the thread count.
+ */
+class SweptCollisions{
+  public:
+    int maxPasses = 4;
+
+    // statistics of the last step
+    long long lastCandidates = 0;
+    int lastImpacts = 0;       // resolved at their time of impact
+    int lastDeferred = 0;      // left to the discrete pass after the last pass
+    int lastPasses = 0;
+
+    // Remember where the particles start the step
+    void begin(const ParticleSystem& ps, const std::vector<int>& indices, ThreadPool& pool);
+
+    // Where particle i's path over the rest of the step starts, and at
+    // which fraction of the step: the start of the step or its last impact
+    glm::vec3 pathStart(int i) const { return glm::vec3(pathX[i], pathY[i], pathZ[i]); }
+    float pathStartTime(int i) const { return pathTime[i]; }
+
+    // Find the pairs among indices whose paths touched this step and
+    // resolve them at their times of impact
+    void resolvePairs(ParticleSystem& ps, const std::vector<int>& indices, const SimParams& params, float deltaTime, ThreadPool& pool);
+
+  private:
+    struct Impact{
+      float t;
+      int i, j;
+    };
+
+    std::vector<float> pathX, pathY, pathZ, pathTime;
+    SpatialGrid grid;
+
+    std::vector<std::vector<Impact>> threadImpacts;
+    std::vector<long long> threadCandidates;
+    std::vector<Impact> impacts;
+    std::vector<char> hit, moved;
+
+    void setPathStart(int i, glm::vec3 p, float t){
+      pathX[i] = p.x;
+      pathY[i] = p.y;
+      pathZ[i] = p.z;
+      pathTime[i] = t;
+    }
+};
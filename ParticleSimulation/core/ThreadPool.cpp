@@ -0,0 +1,131 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads){
+    if (threads <= 0){
+        threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    }
+    numThreads = threads;
+
+    for(int t = 0; t < numThreads; t++){
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    // thread 0 is whoever calls parallelFor
+    for(int t = 1; t < numThreads; t++){
+        workers.emplace_back(&ThreadPool::workerLoop, this, t);
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for(auto& worker : workers){
+        worker.join();
+    }
+}
+
+bool ThreadPool::popChunk(int threadIndex, Chunk& chunk){
+
+    // own deque first, newest chunk (still warm in cache)
+    {
+        WorkQueue& own = *queues[threadIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.chunks.empty()){
+            chunk = own.chunks.back();
+            own.chunks.pop_back();
+            return true;
+        }
+    }
+
+    // then steal the oldest chunk from the other threads
+    for(int offset = 1; offset < numThreads; offset++){
+        WorkQueue& victim = *queues[(threadIndex + offset) % numThreads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.chunks.empty()){
+            chunk = victim.chunks.front();
+            victim.chunks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runOneChunk(int threadIndex){
+    Chunk chunk;
+    if (!popChunk(threadIndex, chunk)){
+        return false;
+    }
+
+    (*job)(chunk.begin, chunk.end, threadIndex);
+    remaining.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+void ThreadPool::workerLoop(int threadIndex){
+    unsigned long long seen = 0;
+
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait(lock, [&]{ return stopping || generation != seen; });
+            if (stopping){
+                return;
+            }
+            seen = generation;
+        }
+
+        while(runOneChunk(threadIndex)){}
+    }
+}
+
+void ThreadPool::parallelForThreads(int begin, int end, int grain, const std::function<void(int, int, int)>& body){
+    int count = end - begin;
+    if (count <= 0){
+        return;
+    }
+
+    grain = std::max(grain, 1);
+
+    // aim for a few chunks per thread so stealing can even out the load
+    int chunkSize = std::max(grain, (count + numThreads * 4 - 1) / (numThreads * 4));
+    int numChunks = (count + chunkSize - 1) / chunkSize;
+
+    if (numThreads == 1 || numChunks == 1){
+        body(begin, end, 0);
+        return;
+    }
+
+    job = &body;
+    remaining.store(numChunks, std::memory_order_relaxed);
+
+    // deal contiguous runs of chunks to each thread
+    for(int c = 0; c < numChunks; c++){
+        int owner = (int)((long long)c * numThreads / numChunks);
+        Chunk chunk{ begin + c * chunkSize, std::min(end, begin + (c + 1) * chunkSize) };
+
+        WorkQueue& queue = *queues[owner];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.chunks.push_back(chunk);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        generation++;
+    }
+    wake.notify_all();
+
+    // the caller works as thread 0 until every chunk has finished
+    while(remaining.load(std::memory_order_acquire) > 0){
+        if (!runOneChunk(0)){
+            std::this_thread::yield();
+        }
+    }
+
+    job = nullptr;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Persistent thread pool with a work-stealing parallel-for.
+ *
+ * parallelFor() cuts [begin, end) into chunks and deals them out to one
+ * deque per thread. Each thread pops from the back of its own deque and,
+ * once that runs dry, steals from the front of the others. The calling
+ * thread takes part as thread 0, so a pool of size 1 has no workers and
+ * simply runs the body inline, exactly like the serial loop.
+ *
+ * Calls must not be nested: the body of a parallelFor may not start
+ * another parallelFor on the same pool.
+ */
+class ThreadPool{
+  public:
+    // numThreads counts the calling thread; 0 picks hardware_concurrency
+    explicit ThreadPool(int numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return numThreads; }
+
+    // body(chunkBegin, chunkEnd, threadIndex); chunks hold at least grain items
+    void parallelForThreads(int begin, int end, int grain, const std::function<void(int, int, int)>& body);
+
+    // body(chunkBegin, chunkEnd) for bodies that don't need the thread index
+    template <typename Fn>
+    void parallelFor(int begin, int end, int grain, Fn&& body){
+      parallelForThreads(begin, end, grain, [&body](int b, int e, int){ body(b, e); });
+    }
+
+  private:
+    struct Chunk{ int begin, end; };
+
+    struct WorkQueue{
+      std::mutex mutex;
+      std::deque<Chunk> chunks;
+    };
+
+    int numThreads = 1;
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    const std::function<void(int, int, int)>* job = nullptr;
+    std::atomic<int> remaining{0};
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    unsigned long long generation = 0;
+    bool stopping = false;
+
+    void workerLoop(int threadIndex);
+    bool popChunk(int threadIndex, Chunk& chunk);
+    bool runOneChunk(int threadIndex);
+};
@@ -0,0 +1,403 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "Simulation.h"
+#include "Scenes.h"
+#include "SimdKernels.h"
+
+/*
+ * Headless batch runner.
+ *
+ * Runs the simulation core flat out with no window or OpenGL context
+ * and reports throughput, so large batches can run on display-less
+ * servers.
+ *
+ * Usage:
+ *   ParticleHeadless [--particles N] [--steps S] [--dt T]
+ *                    [--scene cloud|fountain|polydisperse|explosion|stack|orbits|gas] [--radius R]
+ *                    [--max-radius R] (polydisperse: sizes from --radius up to this)
+ *                    [--speed v] (explosion, gas)
+ *                    [--collisions grid|allpairs|verlet|sap|hgrid|incremental|hash] [--skin factor]
+ *                    [--boundary sphere|open] [--narrowphase batched|scalar] [--ccd on|off]
+ *                    [--events on|off] (event-driven hard spheres, no gravity or damping)
+ *                    [--response swap|xpbd] [--iterations N] (XPBD solver sweeps)
+ *                    [--sleep steps] (calm steps before an island sleeps, 0 = never)
+ *                    [--sleep-energy e] (kinetic energy per unit mass counted as calm)
+ *                    [--block-levels L] (power-of-two timestep levels, 0 = one global step)
+ *                    [--block-accuracy eta] (step as a fraction of the dynamical time)
+ *                    [--seed K]
+ *                    [--threads N]   (0 = every core, 1 = serial)
+ *                    [--kernels simd|scalar]
+ *                    [--integrator verlet|leapfrog|forestruth|yoshida4|yoshida6|omelyan|wisdomholman] (central attractor)
+ *                    [--gravity central|barneshut|direct|pm|fmm] [--G g]
+ *                    [--softening eps] [--theta angle]
+ *                    [--accumulate float|double] [--mesh cells]
+ *                    [--order p] [--reorder steps] (0 = never)
+ */
+
+struct HeadlessOptions{
+    int numParticles = 10000;
+    int numSteps = 1000;
+    float deltaTime = 1.0f / 240.0f;
+    std::string scene = "cloud";
+    float radius = 2.0f;
+    float maxRadius = 20.0f;
+    float speed = 400.0f;
+    std::string boundary = "sphere";
+    std::string narrowphase = "batched";
+    std::string ccd = "off";
+    std::string events = "off";
+    std::string response = "swap";
+    int iterations = 4;
+    int sleep = 0;
+    float sleepEnergy = 50.0f;
+    int blockLevels = 0;
+    float blockAccuracy = 0.25f;
+    std::string collisions = "grid";
+    unsigned seed = 1;
+    int threads = 0;
+    std::string kernels = "simd";
+    std::string gravity = "central";
+    std::string integrator = "verlet";
+    float mutualG = 1.0f;
+    float softening = 2.0f;
+    float theta = 0.5f;
+    std::string accumulate = "float";
+    int mesh = 64;
+    int order = 4;
+    int reorder = 128;
+    float skin = 1.0f;
+};
+
+static void printUsage(const char* program){
+    std::cout << "Usage: " << program
+              << " [--particles N] [--steps S] [--dt T]"
+              << " [--scene cloud|fountain|polydisperse|explosion|stack|orbits|gas] [--radius R] [--max-radius R] [--speed v]"
+              << " [--collisions grid|allpairs|verlet|sap|hgrid|incremental|hash] [--skin factor] [--boundary sphere|open]"
+              << " [--narrowphase batched|scalar] [--ccd on|off] [--events on|off] [--response swap|xpbd] [--iterations N]"
+              << " [--sleep steps] [--sleep-energy e] [--block-levels L] [--block-accuracy eta]"
+              << " [--seed K] [--threads N]"
+              << " [--kernels simd|scalar] [--integrator verlet|leapfrog|forestruth|yoshida4|yoshida6|omelyan|wisdomholman]"
+              << " [--gravity central|barneshut|direct|pm|fmm] [--G g] [--softening eps] [--theta angle]"
+              << " [--accumulate float|double] [--mesh cells] [--order p] [--reorder steps]" << std::endl;
+}
+
+static bool parseOptions(int argc, char** argv, HeadlessOptions& options){
+    for(int i = 1; i < argc; i++){
+        const char* arg = argv[i];
+
+        if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0){
+            return false;
+        }
+
+        if (i + 1 >= argc){
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if (std::strcmp(arg, "--particles") == 0)       options.numParticles = std::atoi(value);
+        else if (std::strcmp(arg, "--steps") == 0)      options.numSteps = std::atoi(value);
+        else if (std::strcmp(arg, "--dt") == 0)         options.deltaTime = (float)std::atof(value);
+        else if (std::strcmp(arg, "--scene") == 0)      options.scene = value;
+        else if (std::strcmp(arg, "--radius") == 0)     options.radius = (float)std::atof(value);
+        else if (std::strcmp(arg, "--max-radius") == 0) options.maxRadius = (float)std::atof(value);
+        else if (std::strcmp(arg, "--speed") == 0)      options.speed = (float)std::atof(value);
+        else if (std::strcmp(arg, "--collisions") == 0) options.collisions = value;
+        else if (std::strcmp(arg, "--boundary") == 0)   options.boundary = value;
+        else if (std::strcmp(arg, "--narrowphase") == 0) options.narrowphase = value;
+        else if (std::strcmp(arg, "--ccd") == 0)        options.ccd = value;
+        else if (std::strcmp(arg, "--events") == 0)     options.events = value;
+        else if (std::strcmp(arg, "--response") == 0) options.response = value;
+        else if (std::strcmp(arg, "--iterations") == 0) options.iterations = std::atoi(value);
+        else if (std::strcmp(arg, "--sleep") == 0)      options.sleep = std::atoi(value);
+        else if (std::strcmp(arg, "--sleep-energy") == 0) options.sleepEnergy = (float)std::atof(value);
+        else if (std::strcmp(arg, "--block-levels") == 0) options.blockLevels = std::atoi(value);
+        else if (std::strcmp(arg, "--block-accuracy") == 0) options.blockAccuracy = (float)std::atof(value);
+        else if (std::strcmp(arg, "--seed") == 0)       options.seed = (unsigned)std::atoi(value);
+        else if (std::strcmp(arg, "--threads") == 0)    options.threads = std::atoi(value);
+        else if (std::strcmp(arg, "--kernels") == 0)    options.kernels = value;
+        else if (std::strcmp(arg, "--gravity") == 0)    options.gravity = value;
+        else if (std::strcmp(arg, "--integrator") == 0) options.integrator = value;
+        else if (std::strcmp(arg, "--G") == 0)          options.mutualG = (float)std::atof(value);
+        else if (std::strcmp(arg, "--softening") == 0)  options.softening = (float)std::atof(value);
+        else if (std::strcmp(arg, "--theta") == 0)      options.theta = (float)std::atof(value);
+        else if (std::strcmp(arg, "--accumulate") == 0) options.accumulate = value;
+        else if (std::strcmp(arg, "--mesh") == 0)       options.mesh = std::atoi(value);
+        else if (std::strcmp(arg, "--order") == 0)      options.order = std::atoi(value);
+        else if (std::strcmp(arg, "--reorder") == 0)    options.reorder = std::atoi(value);
+        else if (std::strcmp(arg, "--skin") == 0)       options.skin = (float)std::atof(value);
+        else{
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if (options.numParticles <= 0 || options.numSteps < 0 || options.deltaTime <= 0.0f){
+        std::cerr << "particles and dt must be positive, steps must not be negative" << std::endl;
+        return false;
+    }
+    if (options.mesh < 8 || (options.mesh & (options.mesh - 1)) != 0){
+        std::cerr << "mesh must be a power of two, at least 8" << std::endl;
+        return false;
+    }
+    if (options.order < 1 || options.order > 8){
+        std::cerr << "order must be between 1 and 8" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    HeadlessOptions options;
+    if (!parseOptions(argc, argv, options)){
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Simulation sim;
+    sim.setThreadCount(options.threads);
+    sim.useSimdKernels = options.kernels != "scalar";
+    sim.batchedNarrowphase = options.narrowphase != "scalar";
+    sim.continuousCollisions = options.ccd == "on";
+    sim.eventDriven = options.events == "on";
+    sim.reorderInterval = options.reorder;
+    sim.allowSleeping = options.sleep > 0;
+    sim.sleepIslands.sleepSteps = options.sleep;
+    sim.sleepIslands.energyThreshold = options.sleepEnergy;
+    sim.maxTimestepLevel = std::min(std::max(options.blockLevels, 0), 16);
+    sim.timestepAccuracy = options.blockAccuracy;
+
+    if (options.collisions == "allpairs"){
+        sim.collisionMode = CollisionMode::AllPairs;
+    }
+    else if (options.collisions == "grid"){
+        sim.collisionMode = CollisionMode::UniformGrid;
+    }
+    else if (options.collisions == "sap"){
+        sim.collisionMode = CollisionMode::SweepAndPrune;
+    }
+    else if (options.collisions == "hash"){
+        sim.collisionMode = CollisionMode::HashGrid;
+    }
+    else if (options.collisions == "incremental"){
+        sim.collisionMode = CollisionMode::IncrementalGrid;
+    }
+    else if (options.collisions == "hgrid"){
+        sim.collisionMode = CollisionMode::HierarchicalGrid;
+    }
+    else if (options.collisions == "verlet"){
+        sim.collisionMode = CollisionMode::NeighbourList;
+        sim.neighbourList.skinFactor = options.skin;
+    }
+    else{
+        std::cerr << "Unknown collision mode " << options.collisions << std::endl;
+        return 1;
+    }
+
+    if (options.response == "swap" || options.response == "xpbd"){
+        sim.contactResponse = options.response == "xpbd" ? ContactResponse::XPBD : ContactResponse::VelocitySwap;
+        sim.contactSolver.iterations = std::max(options.iterations, 1);
+    }
+    else{
+        std::cerr << "Unknown contact response " << options.response << std::endl;
+        return 1;
+    }
+
+    if (options.boundary == "sphere" || options.boundary == "open"){
+        sim.params.sphereBoundary = options.boundary == "sphere";
+    }
+    else{
+        std::cerr << "Unknown boundary " << options.boundary << std::endl;
+        return 1;
+    }
+
+    sim.params.mutualG = options.mutualG;
+    sim.params.softeningLength = options.softening;
+    sim.barnesHut.openingAngle = options.theta;
+    sim.directSum.doubleAccumulation = options.accumulate == "double";
+    sim.particleMesh.gridSize = options.mesh;
+    sim.fastMultipole.openingAngle = options.theta;
+    sim.fastMultipole.expansionOrder = options.order;
+
+    if (options.gravity == "central"){
+        sim.gravityMode = GravityMode::CentralAttractor;
+    }
+    else if (options.gravity == "barneshut"){
+        sim.gravityMode = GravityMode::BarnesHut;
+    }
+    else if (options.gravity == "direct"){
+        sim.gravityMode = GravityMode::DirectSum;
+    }
+    else if (options.gravity == "pm"){
+        sim.gravityMode = GravityMode::ParticleMesh;
+    }
+    else if (options.gravity == "fmm"){
+        sim.gravityMode = GravityMode::FastMultipole;
+    }
+    else{
+        std::cerr << "Unknown gravity mode " << options.gravity << std::endl;
+        return 1;
+    }
+
+    if (options.integrator == "verlet"){
+        sim.integrator = Integrator::Verlet;
+    }
+    else if (options.integrator == "leapfrog"){
+        sim.integrator = Integrator::Leapfrog;
+    }
+    else if (options.integrator == "forestruth"){
+        sim.integrator = Integrator::ForestRuth;
+    }
+    else if (options.integrator == "yoshida4"){
+        sim.integrator = Integrator::Yoshida4;
+    }
+    else if (options.integrator == "yoshida6"){
+        sim.integrator = Integrator::Yoshida6;
+    }
+    else if (options.integrator == "omelyan"){
+        sim.integrator = Integrator::Omelyan;
+    }
+    else if (options.integrator == "wisdomholman"){
+        sim.integrator = Integrator::WisdomHolman;
+    }
+    else{
+        std::cerr << "Unknown integrator " << options.integrator << std::endl;
+        return 1;
+    }
+
+    if (options.scene == "fountain"){
+        addFountainScene(sim, options.numParticles, 0.01f);
+    }
+    else if (options.scene == "cloud"){
+        addCloudScene(sim, options.numParticles, options.radius, options.seed);
+    }
+    else if (options.scene == "explosion"){
+        addExplosionScene(sim, options.numParticles, options.radius, options.speed, options.seed);
+    }
+    else if (options.scene == "gas"){
+        // straight flight between collisions, so no attractor
+        sim.params.gConstant = 0.0f;
+        addGasScene(sim, options.numParticles, options.radius, options.speed, options.seed);
+    }
+    else if (options.scene == "orbits"){
+        addOrbitScene(sim, options.numParticles, options.radius, options.seed);
+    }
+    else if (options.scene == "stack"){
+        // The default well pulls at 10^4 to 10^5 units/s^2 where the stack
+        // lands, which crushes it into overlap that no contact response
+        // holds at this step, so it never comes to rest. A hundredth of it
+        // lets the stack settle (and sleep).
+        sim.params.gConstant *= 0.01f;
+
+        // square columns about twice as tall as they are wide
+        int width = std::max((int)std::cbrt(options.numParticles / 2.0), 1);
+        addStackScene(sim, width, std::max(options.numParticles / (width * width), 1), options.radius, options.seed);
+    }
+    else if (options.scene == "polydisperse"){
+        addPolydisperseScene(sim, options.numParticles, options.radius, std::max(options.maxRadius, options.radius), options.seed);
+    }
+    else{
+        std::cerr << "Unknown scene " << options.scene << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(int s = 0; s < options.numSteps; s++){
+        sim.step(options.deltaTime);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    double particleSteps = (double)sim.particles.size() * options.numSteps;
+
+    std::cout << "particles:        " << sim.particles.size() << "\n"
+              << "threads:          " << sim.threadCount() << "\n"
+              << "gravity:          " << options.gravity << "\n"
+              << "kernels:          " << (sim.useSimdKernels ? simdKernelISA() : "per-particle") << "\n"
+              << "integrator:       " << options.integrator << "\n"
+              << "steps:            " << options.numSteps << "\n"
+              << "dt:               " << options.deltaTime << "\n"
+              << "simulated time:   " << sim.elapsedTime << " s\n"
+              << "wall time:        " << seconds << " s\n"
+              << "steps/s:          " << (seconds > 0.0 ? options.numSteps / seconds : 0.0) << "\n"
+              << "particle-steps/s: " << (seconds > 0.0 ? particleSteps / seconds : 0.0) << "\n"
+              << "kinetic energy:   " << sim.kineticEnergy() << "\n"
+              << "contacts:         " << sim.lastContacts << " of " << sim.lastCandidates << " candidate pairs last step"
+              << (sim.lastBatched ? " (batched narrowphase)" : "") << std::endl;
+
+    if (sim.allowSleeping){
+        std::cout << "sleeping:         " << sim.sleepIslands.sleepingCount() << " of " << sim.activeParticles.size()
+                  << " particles in " << sim.sleepIslands.sleepingIslandCount() << " islands, "
+                  << sim.awakeParticles.size() << " awake in " << sim.sleepIslands.lastIslands << " islands ("
+                  << sim.sleepIslands.awakeFraction() * 100.0 << "% of particle-steps simulated)" << std::endl;
+    }
+
+    if (sim.continuousCollisions){
+        std::cout << "swept collisions: " << sim.sweptCollisions.lastImpacts << " impacts in " << sim.sweptCollisions.lastPasses
+                  << " passes last step, " << sim.sweptCollisions.lastDeferred << " left to the discrete pass" << std::endl;
+    }
+
+    if (sim.eventDriven){
+        std::cout << "hard spheres:     " << sim.hardSpheres.totalCollisions << " collisions; last step "
+                  << sim.hardSpheres.lastCollisions << " collisions, " << sim.hardSpheres.lastWallHits << " wall hits, "
+                  << sim.hardSpheres.lastCrossings << " cell crossings, " << sim.hardSpheres.lastStale << " stale events, "
+                  << sim.hardSpheres.lastCalendarSize << " waiting" << std::endl;
+    }
+
+    if (sim.maxTimestepLevel > 0){
+        std::cout << "block steps:      " << sim.lastUpdatesPerParticle << " updates per particle last step, per level";
+        for(int count : sim.levelCounts){
+            std::cout << " " << count;
+        }
+        std::cout << std::endl;
+    }
+
+    if (sim.contactResponse == ContactResponse::XPBD){
+        std::cout << "contact solver:   XPBD, " << sim.contactSolver.iterations << " iterations over "
+                  << sim.contactSolver.colourCount() << " colours" << std::endl;
+    }
+
+    if (sim.collisionMode == CollisionMode::NeighbourList){
+        std::cout << "list rebuilds:    " << sim.neighbourList.rebuildCount
+                  << " (" << sim.neighbourList.pairCount() << " pairs)" << std::endl;
+    }
+    else if (sim.collisionMode == CollisionMode::SweepAndPrune){
+        std::cout << "sweep axis:       " << "xyz"[std::max(sim.sweepAndPrune.axis, 0)]
+                  << " (" << sim.sweepAndPrune.lastSwaps << " swaps, " << sim.sweepAndPrune.lastPairs << " pairs last step)" << std::endl;
+    }
+    else if (sim.collisionMode == CollisionMode::HashGrid){
+        std::cout << "hash cells:       " << sim.hashGrid.occupiedCells() << " occupied, table of " << sim.hashGrid.tableSize()
+                  << " (" << sim.hashGrid.memoryBytes() / 1024 << " KiB)" << std::endl;
+    }
+    else if (sim.collisionMode == CollisionMode::IncrementalGrid){
+        std::cout << "re-binned:        " << 100.0 * sim.incrementalGrid.rebinnedFraction() << "% of particles per step"
+                  << " (" << sim.incrementalGrid.compactions << " compactions)" << std::endl;
+    }
+    else if (sim.collisionMode == CollisionMode::HierarchicalGrid){
+        std::cout << "grid levels:      " << sim.hierarchicalGrid.levelCount
+                  << " (" << sim.hierarchicalGrid.lastCrossPairs << " cross-level pairs last step)" << std::endl;
+    }
+
+    // force throughput of the last step, to compare gravity modes
+    if (sim.gravityMode == GravityMode::DirectSum){
+        std::cout << "interactions/s:   " << sim.directSum.interactionsPerSecond() << std::endl;
+    }
+    else if (sim.gravityMode == GravityMode::BarnesHut && sim.barnesHut.lastSeconds > 0.0){
+        std::cout << "interactions/s:   " << sim.barnesHut.lastInteractions / sim.barnesHut.lastSeconds << std::endl;
+    }
+    else if (sim.gravityMode == GravityMode::FastMultipole){
+        std::cout << "P2P pairs:        " << sim.fastMultipole.lastInteractions << "\n"
+                  << "M2L cell pairs:   " << sim.fastMultipole.lastCellInteractions << std::endl;
+    }
+
+    return 0;
+}
@@ -1,6 +1,10 @@
+#pragma once
+
 #include <glm/glm.hpp>
 #include <cmath>
 
+#include "Render.h"
+
 class Particle3D{
   public:
     glm::vec3 position, velocity;
@@ -20,36 +24,7 @@ class Particle3D{
     }
 
   void drawParticle3D(int lats, int longs){
-    for(int i = 0; i < lats; i++){
-      float lat0 = M_PI * (-0.5f + (float)i / lats);
-      float z0  = sin(lat0) * radius;
-      float zr0 = cos(lat0) * radius;
-
-      float lat1 = M_PI * (-0.5f + (float)(i+1) / lats);
-      float z1 = sin(lat1) * radius;
-      float zr1 = cos(lat1) * radius;
-
-      glBegin(GL_TRIANGLE_STRIP);
-      for(int j = 0; j <= longs; j++){
-
-        float lng = 2 * M_PI * (float)(j) / longs;
-        float x = cos(lng);
-        float y = sin(lng);
-
-        glm::vec3 v1 = position + glm::vec3(x*zr0, y*zr0, z0);
-        glm::vec3 n1 = glm::normalize(glm::vec3(x*zr0, y*zr0, z0));
-
-        glNormal3f(n1.x, n1.y, n1.z);
-        glVertex3f(v1.x, v1.y, v1.z);
-
-        glm::vec3 v2 = position + glm::vec3(x*zr1, y*zr1, z1);
-        glm::vec3 n2 = glm::normalize(glm::vec3(x*zr1, y*zr1, z1));
-
-        glNormal3f(n2.x, n2.y, n2.z);
-        glVertex3f(v2.x, v2.y, v2.z);
-      }
-      glEnd();
-    }
+    drawParticleSphere(position, radius, lats, longs);
   }
 
   void updatePosition3D(float deltaTime){
@@ -1,4 +1,7 @@
+#pragma once
+
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 #include <cmath>
 
@@ -79,4 +82,38 @@ void drawBoundarySphere(int lats, int longs, int radius){
     }
 
     glEnable(GL_LIGHTING);
-}
\ No newline at end of file
+}
+
+// 3D Particle - lit sphere centred on the particle position
+void drawParticleSphere(glm::vec3 position, float radius, int lats, int longs){
+    for(int i = 0; i < lats; i++){
+        float lat0 = M_PI * (-0.5f + (float)i / lats);
+        float z0  = sin(lat0) * radius;
+        float zr0 = cos(lat0) * radius;
+
+        float lat1 = M_PI * (-0.5f + (float)(i+1) / lats);
+        float z1 = sin(lat1) * radius;
+        float zr1 = cos(lat1) * radius;
+
+        glBegin(GL_TRIANGLE_STRIP);
+        for(int j = 0; j <= longs; j++){
+
+            float lng = 2 * M_PI * (float)(j) / longs;
+            float x = cos(lng);
+            float y = sin(lng);
+
+            glm::vec3 v1 = position + glm::vec3(x*zr0, y*zr0, z0);
+            glm::vec3 n1 = glm::normalize(glm::vec3(x*zr0, y*zr0, z0));
+
+            glNormal3f(n1.x, n1.y, n1.z);
+            glVertex3f(v1.x, v1.y, v1.z);
+
+            glm::vec3 v2 = position + glm::vec3(x*zr1, y*zr1, z1);
+            glm::vec3 n2 = glm::normalize(glm::vec3(x*zr1, y*zr1, z1));
+
+            glNormal3f(n2.x, n2.y, n2.z);
+            glVertex3f(v2.x, v2.y, v2.z);
+        }
+        glEnd();
+    }
+}
@@ -5,10 +5,13 @@
 #include <glm/gtc/constants.hpp>
 
 #include "library/Particle.h"
-#include "library/Particle3D.h"
 #include "library/Camera.h"
 #include "library/Render.h"
 
+#include "Simulation.h"
+#include "Scenes.h"
+#include "SimulationClock.h"
+
 #include <vector>
 #include <cmath>
 
@@ -31,6 +34,16 @@ std::mt19937 gen(rd());
  *  - Elastic particle-to-particle collision handling
  *  - Sphere-boundary collision response
  *  - Time-based spawning system
+ *  - Fixed-timestep physics decoupled from the render frame rate
+ *  - Uniform grid broadphase (press G to cycle through the incremental
+ *    grid, hash grid, Verlet neighbour lists, sweep-and-prune, the
+ *    hierarchical grid and the all-pairs reference)
+ *  - Velocity-swap contact response (press X for the XPBD solver)
+ *  - Optional sleeping of settled islands (Z), block timesteps (B) and
+ *    continuous collision detection (C)
+ *  - Event-driven hard spheres in free flight (H)
+ *  - Higher-order symplectic and Wisdom-Holman integrators for the
+ *    attractor (I)
  */
 
 // Screen Dimension variables
@@ -38,13 +51,14 @@ const float WIDTH = 800.0f;
 const float HEIGHT = 600.0f;
 
 // Frame Timing, and delay in particle drawing
-float elapsedTime = 0.0f;
 double lastFrame = 0.0f; 
 float TimeDelay = 0.01f;
 
-// Array of Particles and spawnTime (float)
-std::vector<Particle3D> particles;
-std::vector<float> spawnTimes;
+// Particles, spawn times and stepping (see core/Simulation.h)
+Simulation sim;
+
+// Physics runs at a fixed 240 Hz, at most 8 substeps per rendered frame
+SimulationClock simClock(1.0 / 240.0, 8);
 
 
 //Initialize camera
@@ -54,66 +68,107 @@ void WindowResize(GLFWwindow* window, int width, int height){
     glViewport(0, 0, width, height);
 }
 
-void drawParticleArray2D(std::vector<Particle>& particles, float deltaTime){
-
-    for(auto& p : particles){        
-        p.updatePosition(deltaTime);
-        p.boundingBoundary(WIDTH, HEIGHT);
-        p.drawParticle();
+void KeyPressed(GLFWwindow* window, int key, int scancode, int action, int mods){
+    if (key == GLFW_KEY_I && action == GLFW_PRESS){
+        if (sim.integrator == Integrator::Verlet){
+            sim.integrator = Integrator::Yoshida4;
+            std::cout << "Integrator: Yoshida 4th order" << std::endl;
+        }
+        else if (sim.integrator == Integrator::Yoshida4){
+            sim.integrator = Integrator::Omelyan;
+            std::cout << "Integrator: Omelyan 4th order" << std::endl;
+        }
+        else if (sim.integrator == Integrator::Omelyan){
+            sim.integrator = Integrator::Yoshida6;
+            std::cout << "Integrator: Yoshida 6th order" << std::endl;
+        }
+        else if (sim.integrator == Integrator::Yoshida6){
+            sim.integrator = Integrator::WisdomHolman;
+            std::cout << "Integrator: Wisdom-Holman Kepler drift" << std::endl;
+        }
+        else{
+            sim.integrator = Integrator::Verlet;
+            std::cout << "Integrator: velocity Verlet" << std::endl;
+        }
     }
-}
 
+    if (key == GLFW_KEY_H && action == GLFW_PRESS){
+        sim.eventDriven = !sim.eventDriven;
+        std::cout << "Event-driven hard spheres: " << (sim.eventDriven ? "on" : "off") << std::endl;
+    }
 
-void SetGravity(Particle3D& particle){
-    
-    glm::vec3 bottom = glm::vec3(0.0f, -400.0f, 0.0f);
-    glm::vec3 direction = bottom - particle.position;
-    float distance = glm::length(direction);
+    if (key == GLFW_KEY_C && action == GLFW_PRESS){
+        sim.continuousCollisions = !sim.continuousCollisions;
+        std::cout << "Continuous collisions: " << (sim.continuousCollisions ? "on" : "off") << std::endl;
+    }
 
-    direction = glm::normalize(direction);
+    if (key == GLFW_KEY_B && action == GLFW_PRESS){
+        sim.maxTimestepLevel = sim.maxTimestepLevel > 0 ? 0 : 6;
+        std::cout << "Block timesteps: " << (sim.maxTimestepLevel > 0 ? "up to 6 levels" : "off") << std::endl;
+    }
 
-    if (distance < 5.0f){
-        distance = 5.0f;
+    if (key == GLFW_KEY_Z && action == GLFW_PRESS){
+        sim.allowSleeping = !sim.allowSleeping;
+        std::cout << "Sleeping: " << (sim.allowSleeping ? "on" : "off")
+                  << ", " << sim.sleepIslands.sleepingCount() << " particles asleep" << std::endl;
     }
 
-    float gConstant = 7000000.0f; 
-    float accelMagnitude = gConstant / (distance * distance);
+    if (key == GLFW_KEY_X && action == GLFW_PRESS){
+        if (sim.contactResponse == ContactResponse::VelocitySwap){
+            sim.contactResponse = ContactResponse::XPBD;
+            std::cout << "Contact response: XPBD, " << sim.contactSolver.iterations << " iterations" << std::endl;
+        }
+        else{
+            sim.contactResponse = ContactResponse::VelocitySwap;
+            std::cout << "Contact response: velocity swap" << std::endl;
+        }
+    }
 
-    particle.acceleration += direction * accelMagnitude;
+    if (key == GLFW_KEY_G && action == GLFW_PRESS){
+        if (sim.collisionMode == CollisionMode::UniformGrid){
+            sim.collisionMode = CollisionMode::IncrementalGrid;
+            std::cout << "Collision mode: incremental grid" << std::endl;
+        }
+        else if (sim.collisionMode == CollisionMode::IncrementalGrid){
+            sim.collisionMode = CollisionMode::HashGrid;
+            std::cout << "Collision mode: hash grid" << std::endl;
+        }
+        else if (sim.collisionMode == CollisionMode::HashGrid){
+            sim.collisionMode = CollisionMode::NeighbourList;
+            std::cout << "Collision mode: Verlet neighbour lists" << std::endl;
+        }
+        else if (sim.collisionMode == CollisionMode::NeighbourList){
+            sim.collisionMode = CollisionMode::SweepAndPrune;
+            std::cout << "Collision mode: sweep and prune" << std::endl;
+        }
+        else if (sim.collisionMode == CollisionMode::SweepAndPrune){
+            sim.collisionMode = CollisionMode::HierarchicalGrid;
+            std::cout << "Collision mode: hierarchical grid" << std::endl;
+        }
+        else if (sim.collisionMode == CollisionMode::HierarchicalGrid){
+            sim.collisionMode = CollisionMode::AllPairs;
+            std::cout << "Collision mode: all pairs" << std::endl;
+        }
+        else{
+            sim.collisionMode = CollisionMode::UniformGrid;
+            std::cout << "Collision mode: uniform grid" << std::endl;
+        }
+    }
 }
 
-void VerletIntegration(Particle3D& particle, float deltaTime){
-
-
-    particle.position += particle.velocity * deltaTime + 0.5f * particle.acceleration * deltaTime * deltaTime;
-
-    glm::vec3 oldAcceleration = particle.acceleration;
-
-    particle.acceleration = glm::vec3(0.0f);
-
-    SetGravity(particle);
+void drawParticleArray2D(std::vector<Particle>& particles, float deltaTime){
 
-    particle.velocity += 0.5f * (oldAcceleration + particle.acceleration) * deltaTime;
+    for(auto& p : particles){        
+        p.updatePosition(deltaTime);
+        p.boundingBoundary(WIDTH, HEIGHT);
+        p.drawParticle();
+    }
 }
 
-void drawParticleArray3D(std::vector<Particle3D>& particles, float deltaTime){
-    for(int i = 0; i < particles.size(); i++){
 
-        // elapsedTime is for the time delay in drawing each particle
-        if(elapsedTime >= spawnTimes[i]){
-            
-            VerletIntegration(particles[i], deltaTime);
-
-            // Detect collision for iteration i against iteration i + 1 (j)
-            for(int j = i+1; j < particles.size(); j++){
-                particles[i].Particle3DCollision(particles[j]);
-            }
-
-            // Boundary Sphere collision
-            particles[i].checkSphereCollision(400);
-
-            particles[i].drawParticle3D(10,10);
-        }
+void drawParticleArray3D(const Simulation& sim){
+    for(int i : sim.activeParticles){
+        drawParticleSphere(sim.particles.position(i), sim.particles.radius[i], 10, 10);
     }
 }
 
@@ -147,6 +202,9 @@ int main(void)
     // resize window
     glfwSetFramebufferSizeCallback(window, WindowResize);
 
+    // toggle collision broadphase
+    glfwSetKeyCallback(window, KeyPressed);
+
     // Depth Test (DepthBuffer)
     glEnable(GL_DEPTH_TEST);
 
@@ -154,34 +212,12 @@ int main(void)
     glEnable(GL_LIGHTING);
     glEnable(GL_LIGHT0);
 
-    //initialize Particle
-    glm::vec3 position(0.0f, 200.0f, 0.0f);
-
-    // spherical rotation and direction
-    const float magnitude = 400.0f;
-    const float anglePhi = glm::radians(-90.0f);
-    const float angleTheta = glm::radians(1.0f);
-
-    // for rotational and directional control
-    float directionX = magnitude*(cos(anglePhi)*cos(angleTheta));
-    float directionY = magnitude*(sin(anglePhi)*sin(angleTheta));
-    float directionZ = magnitude*(sin(angleTheta));
-
-    glm::vec3 velocity = glm::vec3(directionX, directionY, directionZ);
-
-    // variables for particle initialization
-    const float mass = 30.0f;
-    const float radius = 10.0f;
+    // particles fired from one point, each spawning TimeDelay after the last
     int numParticles = 100;
+    addFountainScene(sim, numParticles, TimeDelay);
 
-    // append numParticles to the array of particles and to spawnTimes array
-    for(int i = 0; i < numParticles; i++){
-
-            particles.emplace_back(position, velocity, mass, radius);
-
-            // each particle spawns after 0.1s
-            spawnTimes.push_back(i * TimeDelay); 
-    }
+    // use every core for the per-particle passes
+    sim.setThreadCount(0);
 
     while (!glfwWindowShouldClose(window))
     {
@@ -220,9 +256,12 @@ int main(void)
         glLightfv(GL_LIGHT0, GL_POSITION, light);
 
         // Update
-        elapsedTime += deltaTime;
-        drawParticleArray3D(particles, deltaTime);
-        drawBoundarySphere(20, 20, 400);
+        int substeps = simClock.advance(deltaTime);
+        for(int s = 0; s < substeps; s++){
+            sim.step((float)simClock.fixedDeltaTime);
+        }
+        drawParticleArray3D(sim);
+        drawBoundarySphere(20, 20, sim.params.boundaryRadius);
 
         glfwSwapBuffers(window);
         glfwPollEvents();